@@ -0,0 +1,342 @@
+#include "raylib.h"
+#include "engine.h"
+#include "terrain.h"
+#include "renderer.h"
+#include "entities.h"
+#include "settings.h"
+#include "jobs.h"
+#include "world.h"
+#include "random.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Headless frame benchmark.
+// Generates a fixed-seed map, flies a scripted camera path and renders into
+// the frame buffer only (no window, no GPU). Per-stage timings and a checksum
+// of the final frame are written as JSON so runs can be compared across commits.
+//
+// Usage: bench [--map 1024|2048|4096|8192] [--frames N] [--warmup N]
+//              [--seed N] [--threads N] [--res WxH] [--dynamic-res MS] [--row-major]
+//              [--world-cache] [--max-entities N] [--churn N] [--paint-restore]
+//              [--units N] [--no-mips] [--draw-distance N] [--plane-growth G]
+//              [--ray-march] [--fog]
+//              [--out file.json] [--frame file.png]
+//
+// --world-cache loads the world from the cache (or generates and saves it),
+// terrain_ms then measures the load.
+// --churn N despawns N random entities per frame and spawns N replacements.
+// --paint-restore writes entities into the terrain instead of the overlay.
+// --units N spawns N land units instead of the map preset's count (raise
+// --max-entities to match).
+// --no-mips samples the full-resolution terrain at every distance.
+// --draw-distance N and --plane-growth G set the terrain planes (G = 0
+// spaces them 1 texel apart at every distance).
+// --ray-march renders column by column (RENDER_RAYS), skipping empty space
+// on the terrain mips. --fog adds distance fog (implies --ray-march).
+
+typedef enum {
+  STAGE_CHURN,
+  STAGE_UPDATE,
+  STAGE_PAINT,
+  STAGE_CLEAR,
+  STAGE_RENDER,
+  STAGE_RESTORE,
+  STAGE_FRAME,
+  STAGE_COUNT
+} BenchStage;
+
+static const char *stageNames[STAGE_COUNT] = {
+  "churn", "update", "paint", "clear", "render", "restore", "frame"
+};
+
+typedef struct {
+  int frames;
+  int warmup;
+  unsigned int seed;
+  const char *outPath;
+  const char *framePath;
+  bool rowMajor;
+  bool noMips;
+  int churn;
+  int units;          // -1 = map preset
+} BenchOptions;
+
+static int CompareDouble(const void *a, const void *b) {
+  double da = *(const double*)a;
+  double db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+// Camera circles the map center once, turning a full revolution and
+// bobbing between the lowest and highest allowed altitude twice.
+static void SetBenchCamera(EngineState *state, int frame, int frames) {
+  float t = (float)frame / (float)frames;
+  float center = gameSettings.mapSize / 2.0f;
+  float radius = gameSettings.mapSize / 4.0f;
+
+  state->camera_x = center + cosf(t * 2.0f * PI) * radius;
+  state->camera_y = center + sinf(t * 2.0f * PI) * radius;
+  state->camera_z = CAMERA_MIN_HEIGHT + (CAMERA_CEILING_HEIGHT - CAMERA_MIN_HEIGHT) * (0.5f - 0.5f * cosf(t * 4.0f * PI));
+  state->horizon = -150.0f;
+  state->phi = 0.785398f + t * 2.0f * PI;
+  state->sinphi = sinf(state->phi);
+  state->cosphi = cosf(state->phi);
+  state->deltaTime = 1.0f / 60.0f;
+  state->time = frame * state->deltaTime;
+}
+
+// Despawns count random entities and spawns the same number of each type
+// again, like units dying and reinforcements arriving.
+static void ChurnEntities(EntityManager *manager, const Terrain *terrain, int count, int frame) {
+  uint32_t key = RandomKey(gameSettings.seed, RANDOM_STREAM_CHURN);
+  for (int k = 0; k < count && manager->count > 0; k++) {
+    int index = RandomRange(key, (uint32_t)(frame * count + k), 0, manager->count - 1);
+    EntityType type = (EntityType)manager->type[index];
+    RemoveEntity(manager, GetEntityHandle(manager, index));
+    SpawnEntitySmart(manager, terrain, type, 1);
+  }
+}
+
+// FNV-1a over the raw frame buffer bytes
+static unsigned long long FrameChecksum(const Renderer *renderer) {
+  const unsigned char *bytes = (const unsigned char*)renderer->frameBuffer;
+  unsigned long long hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < (size_t)renderer->width * renderer->height * sizeof(Color); i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static bool ParseOptions(int argc, char **argv, BenchOptions *options) {
+  ApplyMapPreset(2048);
+  options->frames = 300;
+  options->warmup = 10;
+  options->seed = 1337;
+  options->outPath = NULL;
+  options->framePath = NULL;
+  options->rowMajor = false;
+  options->noMips = false;
+  options->churn = 0;
+  options->units = -1;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--row-major") == 0) {
+      options->rowMajor = true;
+      continue;
+    }
+    if (strcmp(arg, "--no-mips") == 0) {
+      options->noMips = true;
+      continue;
+    }
+    if (strcmp(arg, "--ray-march") == 0) {
+      gameSettings.rayMarch = true;
+      continue;
+    }
+    if (strcmp(arg, "--fog") == 0) {
+      gameSettings.fog = true;
+      continue;
+    }
+    if (strcmp(arg, "--world-cache") == 0) {
+      gameSettings.worldCache = true;
+      continue;
+    }
+    if (strcmp(arg, "--paint-restore") == 0) {
+      gameSettings.paintIntoTerrain = true;
+      continue;
+    }
+
+    const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (!value) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return false;
+    }
+
+    if (strcmp(arg, "--map") == 0) {
+      int size = atoi(value);
+      if (size != 1024 && size != 2048 && size != 4096 && size != 8192) {
+        fprintf(stderr, "Unsupported map size %d\n", size);
+        return false;
+      }
+      ApplyMapPreset(size);
+    }
+    else if (strcmp(arg, "--frames") == 0) options->frames = atoi(value);
+    else if (strcmp(arg, "--warmup") == 0) options->warmup = atoi(value);
+    else if (strcmp(arg, "--seed") == 0) options->seed = (unsigned int)strtoul(value, NULL, 10);
+    else if (strcmp(arg, "--threads") == 0) gameSettings.threadCount = atoi(value);
+    else if (strcmp(arg, "--res") == 0) {
+      if (sscanf(value, "%dx%d", &gameSettings.renderWidth, &gameSettings.renderHeight) != 2) {
+        fprintf(stderr, "Invalid resolution %s\n", value);
+        return false;
+      }
+    }
+    else if (strcmp(arg, "--dynamic-res") == 0) {
+      gameSettings.dynamicResolution = true;
+      gameSettings.targetRenderMs = (float)atof(value);
+    }
+    else if (strcmp(arg, "--max-entities") == 0) gameSettings.entityCapacity = atoi(value);
+    else if (strcmp(arg, "--churn") == 0) options->churn = atoi(value);
+    else if (strcmp(arg, "--units") == 0) options->units = atoi(value);
+    else if (strcmp(arg, "--draw-distance") == 0) gameSettings.drawDistance = (float)atof(value);
+    else if (strcmp(arg, "--plane-growth") == 0) {
+      float growth = (float)atof(value);
+      gameSettings.planeGrowth = (growth > 0.0f) ? growth : -1.0f;
+    }
+    else if (strcmp(arg, "--out") == 0) options->outPath = value;
+    else if (strcmp(arg, "--frame") == 0) options->framePath = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return false;
+    }
+    i++;
+  }
+
+  if (options->frames < 1) options->frames = 1;
+  if (options->warmup < 0) options->warmup = 0;
+  if (options->units >= 0) gameSettings.unitCount = options->units;
+  return true;
+}
+
+static void WriteReport(FILE *out, const BenchOptions *options, const Renderer *renderer, double terrainMs,
+                        const char *worldSource, int entityCount, int paintedCount, double *samples[STAGE_COUNT],
+                        unsigned long long checksum) {
+  fprintf(out, "{\n");
+  fprintf(out, "  \"map_size\": %d,\n", gameSettings.mapSize);
+  fprintf(out, "  \"seed\": %u,\n", options->seed);
+  fprintf(out, "  \"frames\": %d,\n", options->frames);
+  fprintf(out, "  \"threads\": %d,\n", GetJobThreadCount());
+  fprintf(out, "  \"resolution\": [%d, %d],\n", renderer->width, renderer->height);
+  fprintf(out, "  \"column_major\": %s,\n", options->rowMajor ? "false" : "true");
+  fprintf(out, "  \"terrain_mips\": %s,\n", renderer->terrainMips ? "true" : "false");
+  fprintf(out, "  \"render_mode\": \"%s\",\n", (renderer->mode == RENDER_RAYS) ? "rays" : "planes");
+  fprintf(out, "  \"fog\": %s,\n", renderer->fog ? "true" : "false");
+  fprintf(out, "  \"draw_distance\": %.0f,\n", renderer->planesDistance);
+  fprintf(out, "  \"planes\": %d,\n", renderer->plane_count);
+  fprintf(out, "  \"entities\": %d,\n", entityCount);
+  fprintf(out, "  \"painted_entities\": %d,\n", paintedCount);
+  fprintf(out, "  \"entity_path\": \"%s\",\n", gameSettings.paintIntoTerrain ? "paint_restore" : "overlay");
+  fprintf(out, "  \"world\": \"%s\",\n", worldSource);
+  fprintf(out, "  \"terrain_ms\": %.3f,\n", terrainMs);
+  fprintf(out, "  \"terrain_stages_ms\": {");
+  for (int s = 0; s < TERRAIN_STAGE_COUNT; s++) {
+    fprintf(out, " \"%s\": %.3f%s", terrainStageNames[s], terrainStageMs[s], (s + 1 < TERRAIN_STAGE_COUNT) ? "," : " },\n");
+  }
+  fprintf(out, "  \"stages_ms\": {\n");
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    double *v = samples[s];
+    int n = options->frames;
+    qsort(v, n, sizeof(double), CompareDouble);
+    int p99 = (int)ceil(n * 0.99) - 1;
+    if (p99 < 0) p99 = 0;
+    fprintf(out, "    \"%s\": { \"min\": %.4f, \"median\": %.4f, \"p99\": %.4f }%s\n",
+            stageNames[s], v[0], v[n / 2], v[p99], (s + 1 < STAGE_COUNT) ? "," : "");
+  }
+  fprintf(out, "  },\n");
+  fprintf(out, "  \"checksum\": \"%016llx\"\n", checksum);
+  fprintf(out, "}\n");
+}
+
+int main(int argc, char **argv)
+{
+  BenchOptions options;
+  gameSettings.gameMode = MODE_GAME;
+  gameSettings.headless = true;
+  if (!ParseOptions(argc, argv, &options)) return 1;
+
+  SetTraceLogLevel(LOG_WARNING);
+  gameSettings.seed = options.seed;
+
+  EngineState engineState;
+  Terrain terrain;
+  Renderer *renderer = (Renderer*)malloc(sizeof(Renderer));
+  EntityManager *entityManager = (EntityManager*)malloc(sizeof(EntityManager));
+
+  InitEngine(&engineState);
+  InitRenderer(renderer);
+  renderer->columnMajor = !options.rowMajor;
+  renderer->terrainMips = !options.noMips;
+
+  InitEntityManager(entityManager, gameSettings.entityCapacity);
+
+  // Terrain time covers the cache load or the generation plus spawning
+  const char *worldSource = "generated";
+  const char *worldPath = GetWorldCachePath();
+  double terrainStart = GetEngineTime();
+  if (gameSettings.worldCache && LoadWorld(worldPath, &terrain, entityManager)) {
+    worldSource = "cache";
+  } else {
+    GenerateProceduralTerrain(&terrain, NULL);
+    SpawnEntitySmart(entityManager, &terrain, ENTITY_SHIP, gameSettings.shipCount);
+    SpawnEntitySmart(entityManager, &terrain, ENTITY_UNIT, gameSettings.unitCount);
+    SpawnEntitySmart(entityManager, &terrain, ENTITY_BUILDING, gameSettings.buildingCount);
+  }
+  double terrainMs = (GetEngineTime() - terrainStart) * 1000.0;
+  if (gameSettings.worldCache && strcmp(worldSource, "generated") == 0) SaveWorld(worldPath, &terrain, entityManager);
+
+  double *samples[STAGE_COUNT];
+  for (int s = 0; s < STAGE_COUNT; s++) {
+    samples[s] = (double*)malloc(options.frames * sizeof(double));
+  }
+
+  int totalFrames = options.warmup + options.frames;
+  for (int frame = 0; frame < totalFrames; frame++) {
+    double t[STAGE_COUNT + 1];
+    SetBenchCamera(&engineState, frame, totalFrames);
+
+    t[0] = GetEngineTime();
+    if (options.churn > 0) ChurnEntities(entityManager, &terrain, options.churn, frame);
+    t[1] = GetEngineTime();
+    UpdateEntities(entityManager, engineState.deltaTime, &terrain);
+    t[2] = GetEngineTime();
+    PaintEntities(entityManager, &terrain, &engineState);
+    t[3] = GetEngineTime();
+    ClearFrameBuffer(renderer, renderer->sky_color);
+    t[4] = GetEngineTime();
+    DrawVertexSpace(renderer, &engineState, &terrain, GetEntityOverlay(entityManager));
+    t[5] = GetEngineTime();
+    RestoreEntities(entityManager, &terrain);
+    t[6] = GetEngineTime();
+
+    if (frame < options.warmup) continue;
+    int i = frame - options.warmup;
+    for (int s = 0; s < STAGE_FRAME; s++) {
+      samples[s][i] = (t[s + 1] - t[s]) * 1000.0;
+    }
+    samples[STAGE_FRAME][i] = (t[STAGE_FRAME] - t[0]) * 1000.0;
+  }
+
+  unsigned long long checksum = FrameChecksum(renderer);
+
+  WriteReport(stdout, &options, renderer, terrainMs, worldSource, entityManager->count, entityManager->paintedCount, samples, checksum);
+  if (options.outPath) {
+    FILE *f = fopen(options.outPath, "w");
+    if (f) {
+      WriteReport(f, &options, renderer, terrainMs, worldSource, entityManager->count, entityManager->paintedCount, samples, checksum);
+      fclose(f);
+    }
+  }
+
+  if (options.framePath) {
+    Image frame = {
+      .data = renderer->frameBuffer,
+      .width = renderer->width,
+      .height = renderer->height,
+      .mipmaps = 1,
+      .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
+    };
+    ExportImage(frame, options.framePath);
+  }
+
+  for (int s = 0; s < STAGE_COUNT; s++) free(samples[s]);
+  UnloadEntityManager(entityManager);
+  free(entityManager);
+  UnloadTerrain(&terrain);
+  CloseRenderer(renderer);
+  free(renderer);
+  CloseEngine();
+
+  return 0;
+}
@@ -2,22 +2,69 @@
 #define CONSTANTS_H
 
 
+// Default internal render resolution. The projection is tuned for
+// GAME_HEIGHT and scaled for other heights at runtime.
 #define GAME_WIDTH 1280
 #define GAME_HEIGHT 720  // 16:9 aspect ratio
 
-#define MAX_PLANES 1782
+// Dynamic resolution
+#define MIN_RENDER_WIDTH 160
+#define MIN_RENDER_HEIGHT 90
+#define MIN_RENDER_SCALE 0.35f          // Lowest fraction of the configured resolution
+#define DEFAULT_TARGET_RENDER_MS 8.0f   // DrawVertexSpace budget per frame
+
+#define MAX_PLANES 1782                // Capacity of the renderer's plane list
+#define DEFAULT_DRAW_DISTANCE 1781.0f  // Farthest terrain plane, map texels
+#define DEFAULT_PLANE_GROWTH 0.005f    // Plane spacing as a fraction of the distance (at least 1)
 #define MAP_Z_SCALE 256.0f
 #define MOVE_SPEED 180.0f
 #define LOD_FACTOR 512
 #define CAMERA_MIN_HEIGHT 255
 #define CAMERA_CEILING_HEIGHT 1024
 
+// Multithreading
+#define MAX_WORKER_THREADS 32
+#define RENDER_STRIP_WIDTH 64 // Screen columns per render job
+#define TRANSPOSE_TILE 16     // Tile edge for the column-major -> row-major copy
+#define OCCLUSION_GROUP_SHIFT 3 // Columns per occlusion group (log2), see DrawVertexSpaceStrip
+#define OCCLUSION_GROUP (1 << OCCLUSION_GROUP_SHIFT)
+
 // Mouselook Settings
 #define MOUSE_SENSITIVITY_X 0.003f
 #define MOUSE_SENSITIVITY_Y 2.0f
 
-#define MAX_ENTITIES 4096
-#define MAX_ENTITY_SIZE 32 // Maximum width/height in map pixels
+#define MAX_ENTITIES 4096 // Default entity capacity
+#define MAX_ENTITY_SIZE 32 // Maximum model width/height in map pixels
+#define ENTITY_SAVE_ARENA_INITIAL (64 * 1024) // Texels, Paint & Restore saves grow from here
+#define ENTITY_GRID_CELL_SHIFT 5 // Spatial grid cells are 32x32 map texels (MAX_ENTITY_SIZE)
+
+// Entity simulation runs at a fixed rate, independent of the frame rate;
+// rendering interpolates between the last two steps.
+#define SIM_TICK_RATE 30
+#define SIM_STEP (1.0f / SIM_TICK_RATE)
+#define MAX_SIM_STEPS_PER_FRAME 5  // Beyond this the world slows down instead of stalling
+#define ENTITY_JOB_BATCH 1024      // Entities per simulation job
+#define ENTITY_SIMD_STRIP 64       // Entities per pass of the vectorized movement kernel
+
+// Terrain storage: maps are stored as TERRAIN_TILE x TERRAIN_TILE tiles
+// so nearby samples share cache lines and pages at any view angle.
+#define TERRAIN_TILE_SHIFT 6
+#define TERRAIN_TILE (1 << TERRAIN_TILE_SHIFT)
+#define TERRAIN_TILE_MASK (TERRAIN_TILE - 1)
+
+// Terrain mip levels below the full-resolution map (max height, blended
+// color), sampled by planes whose column spacing covers 2^level texels
+#define TERRAIN_MIP_LEVELS 6
+
+// Empty-space skipping along rays (RENDER_RAYS, picking)
+#define RAY_SKIP_MIN_LEVEL 2   // Finest mip block a ray tries to skip
+#define RAY_SKIP_MARGIN 16     // Height a sample must be hidden by before the ray tries
+#define RAY_SKIP_BACKOFF 64    // Most hidden samples a ray lets pass after failed tries
+
+// Distance fog (RENDER_RAYS): terrain fades into the sky color from
+// DEFAULT_FOG_START * farthest plane distance out to that plane in FOG_LEVELS steps
+#define FOG_LEVELS 16
+#define DEFAULT_FOG_START 0.6f
 
 // Fixed-point math constants
 #define FIXED_POINT_SHIFT 16
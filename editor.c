@@ -20,15 +20,6 @@
 // Preview Terrain Size
 #define PREVIEW_MAP_SIZE 512
 
-
-
-static const Color PALETTE[32] = {
-    DB_BLACK, DB_VALHALLA, DB_LOULOU, DB_OILED_CEDAR, DB_ROPE, DB_TAHITI_GOLD, DB_TWINE, DB_PANCHO,
-    DB_GOLDEN_FIZZ, DB_ATLANTIS, DB_CHRISTI, DB_ELF_GREEN, DB_DELL, DB_VERDUN_GREEN, DB_OPAL, DB_DEEP_KOAMARU,
-    DB_VENICE_BLUE, DB_ROYAL_BLUE, DB_KURT, DB_WIND_BLUE, DB_LINK_WATER, DB_WHITE, DB_SILVER, DB_IRON,
-    DB_SHUTTLE_GREY, DB_CASCADE, DB_MING, DB_MOZART, DB_OLD_ROSE, DB_MAUVELOUS, DB_APPLE_BLOSSOM, DB_SAPLING
-};
-
 static VoxelModel currentModel;
 static Color selectedColor = DB_MOZART;
 static int selectedHeight = 10;
@@ -128,8 +119,7 @@ void HandleGridInput() {
 void UpdatePreviewTerrain(Terrain *t) {
     // Clear to Water
     for(int i=0; i<PREVIEW_MAP_SIZE*PREVIEW_MAP_SIZE; i++) {
-        t->heightmapRaw[i] = LEVEL_WATER;
-        t->colormapData[i] = DB_VENICE_BLUE; // Water
+        t->texels[i] = PackTexel(LEVEL_WATER, ShadeIndex(PAL_VENICE_BLUE, SHADE_BASE)); // Water
     }
 
     // Paint Model in center
@@ -140,15 +130,13 @@ void UpdatePreviewTerrain(Terrain *t) {
         for(int x=0; x<currentModel.width; x++) {
             int modelIndex = y * MAX_ENTITY_SIZE + x;
             if (currentModel.heights[modelIndex] > 0) {
-                int mapIndex = (cy + y) * PREVIEW_MAP_SIZE + (cx + x);
-                // Ensure bounds
-                if (mapIndex >= 0 && mapIndex < PREVIEW_MAP_SIZE*PREVIEW_MAP_SIZE) {
-                    t->heightmapRaw[mapIndex] = LEVEL_WATER + currentModel.heights[modelIndex];
-                    t->colormapData[mapIndex] = currentModel.colors[modelIndex];
-                }
+                int mapIndex = TerrainIndexWrapped(t, cx + x, cy + y);
+                t->texels[mapIndex] = PackTexel(LEVEL_WATER + currentModel.heights[modelIndex], PaletteIndex(currentModel.colors[modelIndex]));
             }
         }
     }
+
+    BuildTerrainMips(t);
 }
 
 void RunEditor(void) {
@@ -168,12 +156,12 @@ void RunEditor(void) {
     state.camera_y = PREVIEW_MAP_SIZE / 2.0f + 40.0f;
     state.camera_z = 100.0f;
     state.horizon = 100.0f;
+    state.drawDistance = DEFAULT_DRAW_DISTANCE;
     state.phi = 0;
 
     // Setup Preview Terrain
     Terrain terrain;
-    terrain.heightmapRaw = (unsigned char*)malloc(PREVIEW_MAP_SIZE * PREVIEW_MAP_SIZE);
-    terrain.colormapData = (Color*)malloc(PREVIEW_MAP_SIZE * PREVIEW_MAP_SIZE * sizeof(Color));
+    AllocTerrain(&terrain, PREVIEW_MAP_SIZE);
 
     Renderer renderer;
     InitRenderer(&renderer);
@@ -208,7 +196,7 @@ void RunEditor(void) {
 
         // Render 3D View
         ClearFrameBuffer(&renderer, renderer.sky_color);
-        DrawVertexSpace(&renderer, &state, &terrain);
+        DrawVertexSpace(&renderer, &state, &terrain, NULL);
         UpdateRendererTexture(&renderer);
 
         BeginDrawing();
@@ -217,7 +205,7 @@ void RunEditor(void) {
         // Draw 3D Preview on Right
         Rectangle viewRect = { 800, 0, 800, 900 };
         DrawTexturePro(renderer.screenTexture,
-                       (Rectangle){0, 0, GAME_WIDTH, GAME_HEIGHT},
+                       (Rectangle){0, 0, renderer.width, renderer.height},
                        viewRect, (Vector2){0,0}, 0.0f, WHITE);
         
         // Scanlines/Overlay effect for 3D view
@@ -283,17 +271,17 @@ void RunEditor(void) {
 
         DrawText("SPECTRUM", palX, palY - 25, 20, THEME_TEXT);
 
-        for(int i=0; i<32; i++) {
+        for(int i=0; i<PALETTE_SIZE; i++) {
             int px = i % 8;
             int py = i / 8;
 
             Rectangle r = { palX + px * swatchSize, palY + py * swatchSize, swatchSize, swatchSize };
 
-            DrawRectangleRec(r, PALETTE[i]);
+            DrawRectangleRec(r, dbPalette[i]);
             DrawRectangleLinesEx(r, 1, THEME_BG);
 
             // Selection highlight
-            if (selectedColor.r == PALETTE[i].r && selectedColor.g == PALETTE[i].g && selectedColor.b == PALETTE[i].b) {
+            if (selectedColor.r == dbPalette[i].r && selectedColor.g == dbPalette[i].g && selectedColor.b == dbPalette[i].b) {
                 DrawRectangleLinesEx(r, 2, WHITE);
             }
 
@@ -301,7 +289,7 @@ void RunEditor(void) {
             if (CheckCollisionPointRec(GetMousePosition(), r)) {
                 DrawRectangleLinesEx(r, 2, THEME_ACCENT_LIGHT);
                 if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-                    selectedColor = PALETTE[i];
+                    selectedColor = dbPalette[i];
                 }
             }
         }
@@ -369,8 +357,7 @@ void RunEditor(void) {
 
     // Cleanup
     gameSettings.mapSize = oldMapSize;
-    free(terrain.heightmapRaw);
-    free(terrain.colormapData);
+    UnloadTerrain(&terrain);
     CloseRenderer(&renderer);
     CloseWindow();
 }
@@ -1,17 +1,25 @@
+#define _POSIX_C_SOURCE 200809L
 #include "engine.h"
 #include <math.h>
+#include <time.h>
 
 #include "settings.h"
+#include "jobs.h"
 
 void InitEngine(EngineState *state) {
-  InitWindow(0, 0, "Vertex Space - Huge Terrain");
-  ToggleFullscreen();
-  SetTargetFPS(60);
+  if (!gameSettings.headless) {
+    InitWindow(0, 0, "Vertex Space - Huge Terrain");
+    ToggleFullscreen();
+    SetTargetFPS(60);
+  }
+
+  InitJobSystem(gameSettings.threadCount);
 
   state->camera_x = gameSettings.mapSize / 2.0f;
   state->camera_y = gameSettings.mapSize / 2.0f;
   state->camera_z = 600.0f;
   state->horizon = -150.0f;
+  state->drawDistance = (gameSettings.drawDistance > 0.0f) ? gameSettings.drawDistance : DEFAULT_DRAW_DISTANCE;
   state->phi = 0.785398f;
   state->demoMode = false;
   state->cursorLocked = false;
@@ -26,5 +34,13 @@ void UpdateEngine(EngineState *state) {
 }
 
 void CloseEngine(void) {
-  CloseWindow();
+  CloseJobSystem();
+  if (!gameSettings.headless) CloseWindow();
+}
+
+double GetEngineTime(void) {
+  // Monotonic clock that also works without a window (raylib's GetTime needs one)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
 }
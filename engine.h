@@ -9,6 +9,7 @@ typedef struct {
     float camera_y;
     float camera_z;
     float horizon;
+    float drawDistance;  // Farthest terrain plane, map texels
     float phi;
     float sinphi;
     float cosphi;
@@ -21,5 +22,6 @@ typedef struct {
 void InitEngine(EngineState *state);
 void UpdateEngine(EngineState *state);
 void CloseEngine(void);
+double GetEngineTime(void); // Seconds, monotonic
 
 #endif // ENGINE_H
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "entities.h"
 #include "settings.h"
 #include "constants.h"
+#include "random.h"
+#include "jobs.h"
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
@@ -13,6 +15,165 @@ void InitModelRegistry() {
     modelRegistry.count = 0;
 }
 
+// Model texel drawn at (dx, dy) of the footprint for a facing.
+// Assume Default Model Orientation is UP (Facing 3).
+static void ModelCoordinates(int facing, int width, int length, int dx, int dy, int *modX, int *modY) {
+    if (facing == 0) { // Right
+        // 90 Deg Clockwise from Up
+        // modX maps to dy
+        // modY maps to reversed dx
+        *modX = dy;
+        *modY = length - 1 - dx;
+    }
+    else if (facing == 1) { // Down
+        // 180 Deg
+        *modX = width - 1 - dx;
+        *modY = length - 1 - dy;
+    }
+    else if (facing == 2) { // Left
+        // 270 Deg Clockwise (90 CCW) from Up
+        // modX maps to reversed dy
+        // modY maps to dx
+        *modX = width - 1 - dy;
+        *modY = dx;
+    }
+    else { // Up (3)
+        // Identity
+        *modX = dx;
+        *modY = dy;
+    }
+}
+
+// Crops a drawW x drawH footprint (MAX_ENTITY_SIZE stride) to its
+// non-empty voxels and packs it into v
+static void PackVariant(ModelVariant *v, int drawW, int drawH, const unsigned char *heights, const unsigned char *colors) {
+    int minX = drawW, minY = drawH, maxX = -1, maxY = -1;
+    for (int dy = 0; dy < drawH; dy++) {
+        for (int dx = 0; dx < drawW; dx++) {
+            if (heights[dy * MAX_ENTITY_SIZE + dx] == 0) continue;
+            if (dx < minX) minX = dx;
+            if (dx > maxX) maxX = dx;
+            if (dy < minY) minY = dy;
+            if (dy > maxY) maxY = dy;
+        }
+    }
+
+    if (maxX < 0) {
+        v->x = v->y = 0;
+        v->width = v->length = 0;
+        return;
+    }
+
+    // Footprints are centered on the entity position
+    v->x = minX - drawW / 2;
+    v->y = minY - drawH / 2;
+    v->width = maxX - minX + 1;
+    v->length = maxY - minY + 1;
+
+    for (int y = 0; y < v->length; y++) {
+        for (int x = 0; x < v->width; x++) {
+            int src = (minY + y) * MAX_ENTITY_SIZE + minX + x;
+            v->heights[y * v->width + x] = heights[src];
+            v->colorIndex[y * v->width + x] = colors[src];
+        }
+    }
+}
+
+static void BuildModelVariants(VoxelModel *m) {
+    unsigned char heights[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
+    unsigned char colors[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
+
+    for (int facing = 0; facing < 4; facing++) {
+        // Horizontal facings (Right / Left) swap the footprint
+        bool horizontal = (facing == 0 || facing == 2);
+        int drawW = horizontal ? m->length : m->width;
+        int drawH = horizontal ? m->width : m->length;
+
+        for (int dy = 0; dy < drawH; dy++) {
+            for (int dx = 0; dx < drawW; dx++) {
+                int modX, modY;
+                ModelCoordinates(facing, m->width, m->length, dx, dy, &modX, &modY);
+                heights[dy * MAX_ENTITY_SIZE + dx] = m->heights[modY * MAX_ENTITY_SIZE + modX];
+                colors[dy * MAX_ENTITY_SIZE + dx] = m->colorIndex[modY * MAX_ENTITY_SIZE + modX];
+            }
+        }
+        PackVariant(&m->variants[facing], drawW, drawH, heights, colors);
+    }
+}
+
+// Procedural stand-ins for entities without a model file
+static VoxelModel fallbackModels[ENTITY_BUILDING + 1];
+
+static void BuildFallbackModel(VoxelModel *m, EntityType type) {
+    int height;
+    Color color;
+    m->name[0] = 0;
+    m->type = type;
+
+    if (type == ENTITY_SHIP) {
+        m->width = 8;
+        m->length = 20;
+        height = 8;
+        color = (Color){100, 100, 110, 255};
+    } else if (type == ENTITY_UNIT) {
+        m->width = 2;
+        m->length = 2;
+        height = 4;
+        color = BLACK;
+    } else {
+        m->width = 8;
+        m->length = 8;
+        height = 8;
+        color = BROWN;
+    }
+
+    unsigned char bodyC = PaletteIndex(color);
+    unsigned char edgeC = PaletteIndex((Color){color.r/2, color.g/2, color.b/2, 255});
+    unsigned char cabinC = PaletteIndex(RAYWHITE);
+    unsigned char roofC = PaletteIndex((Color){160, 82, 45, 255});
+
+    unsigned char heights[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
+    unsigned char colors[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
+
+    // The shapes are laid out on the footprint, not rotated with it
+    for (int facing = 0; facing < 4; facing++) {
+        bool horizontal = (facing == 0 || facing == 2);
+        int drawW = horizontal ? m->length : m->width;
+        int drawH = horizontal ? m->width : m->length;
+
+        for (int dy = 0; dy < drawH; dy++) {
+            for (int dx = 0; dx < drawW; dx++) {
+                int h = height;
+                unsigned char c = (dx == 0 || dx == drawW-1 || dy == 0 || dy == drawH-1) ? edgeC : bodyC;
+
+                if (type == ENTITY_SHIP) {
+                    // Just draw a "cabin" in the middle-ish
+                    if (dx >= drawW/4 && dx <= drawW*3/4 && dy >= drawH/4 && dy <= drawH/2) {
+                        h += 4;
+                        c = cabinC;
+                    }
+                }
+                else if (type == ENTITY_BUILDING) {
+                    int cx = drawW / 2;
+                    int cy = drawH / 2;
+                    int distX = abs(dx - cx);
+                    int distY = abs(dy - cy);
+                    int dist = (distX > distY) ? distX : distY;
+                    int roofHeight = (cx - dist) * 2;
+                    if (roofHeight > 0) {
+                        h += roofHeight;
+                        c = roofC;
+                    }
+                }
+
+                heights[dy * MAX_ENTITY_SIZE + dx] = (unsigned char)h;
+                colors[dy * MAX_ENTITY_SIZE + dx] = c;
+            }
+        }
+        PackVariant(&m->variants[facing], drawW, drawH, heights, colors);
+    }
+}
+
 void LoadModelFromFile(const char* filepath, EntityType type) {
     if (modelRegistry.count >= MAX_LOADED_MODELS) return;
     
@@ -39,6 +200,7 @@ void LoadModelFromFile(const char* filepath, EntityType type) {
                 int idx = y * MAX_ENTITY_SIZE + x;
                 m->heights[idx] = (unsigned char)h;
                 m->colors[idx] = (Color){r,g,b,a};
+                m->colorIndex[idx] = PaletteIndex(m->colors[idx]);
             }
         }
     }
@@ -51,6 +213,7 @@ void LoadModelFromFile(const char* filepath, EntityType type) {
     if (ext) *ext = 0;
     
     m->type = type;
+    BuildModelVariants(m);
     
     fclose(f);
     modelRegistry.count++;
@@ -73,7 +236,11 @@ void LoadModelsFromDir(const char* dirname, EntityType type) {
 }
 
 void LoadAllModels() {
+    InitPalette();
     InitModelRegistry();
+    for (int t = ENTITY_SHIP; t <= ENTITY_BUILDING; t++) {
+        BuildFallbackModel(&fallbackModels[t], (EntityType)t);
+    }
     LoadModelsFromDir("models/ship", ENTITY_SHIP);
     LoadModelsFromDir("models/unit", ENTITY_UNIT);
     LoadModelsFromDir("models/building", ENTITY_BUILDING);
@@ -106,7 +273,18 @@ void SaveModel(const VoxelModel *model) {
     TraceLog(LOG_INFO, "Saved model to %s", path);
 }
 
-VoxelModel* GetRandomModel(EntityType type) {
+// Next value of the entity's own random stream, in [min, max]
+static int EntityRandom(EntityManager *manager, int i, int min, int max) {
+    return RandomRange(manager->rngKey[i], manager->rngCounter[i]++, min, max);
+}
+
+// Facing follows the dominant velocity axis
+static unsigned char FacingFromVelocity(float dx, float dy) {
+    if (fabsf(dx) > fabsf(dy)) return (dx > 0) ? 0 : 2;
+    return (dy > 0) ? 1 : 3;
+}
+
+VoxelModel* GetRandomModel(EntityType type, uint32_t random) {
     int indices[MAX_LOADED_MODELS];
     int count = 0;
     for(int i=0; i<modelRegistry.count; i++) {
@@ -116,329 +294,824 @@ VoxelModel* GetRandomModel(EntityType type) {
     }
     
     if (count > 0) {
-        return &modelRegistry.models[indices[GetRandomValue(0, count-1)]];
+        return &modelRegistry.models[indices[random % (uint32_t)count]];
     }
     return NULL;
 }
 
-void InitEntityManager(EntityManager *manager) {
+void InitEntityManager(EntityManager *manager, int capacity) {
     LoadAllModels(); // Load models on init
+    if (capacity <= 0) capacity = MAX_ENTITIES;
+
     manager->count = 0;
-    for(int i=0; i<MAX_ENTITIES; i++) {
-        manager->list[i].active = false;
+    manager->capacity = capacity;
+    manager->spawnSerial = 0;
+    manager->paintedCount = 0;
+    manager->simAccumulator = 0.0f;
+    manager->simAlpha = 0.0f;
+
+    manager->x = (float*)malloc(capacity * sizeof(float));
+    manager->y = (float*)malloc(capacity * sizeof(float));
+    manager->prevX = (float*)malloc(capacity * sizeof(float));
+    manager->prevY = (float*)malloc(capacity * sizeof(float));
+    manager->dx = (float*)malloc(capacity * sizeof(float));
+    manager->dy = (float*)malloc(capacity * sizeof(float));
+    manager->facing = (unsigned char*)malloc(capacity);
+    manager->type = (unsigned char*)malloc(capacity);
+    manager->rngKey = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    manager->rngCounter = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    manager->model = (const VoxelModel**)malloc(capacity * sizeof(VoxelModel*));
+    manager->width = (unsigned short*)malloc(capacity * sizeof(unsigned short));
+    manager->length = (unsigned short*)malloc(capacity * sizeof(unsigned short));
+    manager->z_offset = (unsigned char*)malloc(capacity);
+    manager->speed = (float*)malloc(capacity * sizeof(float));
+    manager->paint = (EntityRect*)malloc(capacity * sizeof(EntityRect));
+    manager->saveOffset = (size_t*)malloc(capacity * sizeof(size_t));
+    manager->saveArenaCapacity = ENTITY_SAVE_ARENA_INITIAL;
+    manager->saveArenaUsed = 0;
+    manager->saveArena = (TerrainTexel*)malloc(manager->saveArenaCapacity * sizeof(TerrainTexel));
+    manager->overlay = (TerrainOverlay){0}; // Sized to the terrain by the first PaintEntities
+
+    manager->slotIndex = (int*)malloc(capacity * sizeof(int));
+    manager->slotGeneration = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    manager->denseSlot = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+
+    // Every slot starts on the free list
+    for (int s = 0; s < capacity; s++) {
+        manager->slotIndex[s] = (s + 1 < capacity) ? s + 1 : -1;
+        manager->slotGeneration[s] = 1;
     }
+    manager->freeSlot = 0;
+
+    InitEntityGrid(&manager->grid, gameSettings.mapSize, capacity);
+    int cellCount = EntityGridCellsPerRow(&manager->grid) * EntityGridCellsPerRow(&manager->grid);
+    manager->colliders = (EntityCollider*)malloc(capacity * sizeof(EntityCollider));
+    manager->colliderStart = (int*)malloc((cellCount + 1) * sizeof(int));
+    manager->pushX = (float*)malloc(capacity * sizeof(float));
+    manager->pushY = (float*)malloc(capacity * sizeof(float));
 }
 
-void AddEntityFromModel(EntityManager *manager, EntityType type, float x, float y, const VoxelModel *model) {
-    int slot = -1;
-    // Find first inactive slot
-    for(int i=0; i<MAX_ENTITIES; i++) {
-        if(!manager->list[i].active) {
-            slot = i;
-            break;
-        }
-    }
-    
+void UnloadEntityManager(EntityManager *manager) {
+    free(manager->x);
+    free(manager->y);
+    free(manager->prevX);
+    free(manager->prevY);
+    free(manager->dx);
+    free(manager->dy);
+    free(manager->facing);
+    free(manager->type);
+    free(manager->rngKey);
+    free(manager->rngCounter);
+    free(manager->model);
+    free(manager->width);
+    free(manager->length);
+    free(manager->z_offset);
+    free(manager->speed);
+    free(manager->paint);
+    free(manager->saveOffset);
+    free(manager->saveArena);
+    manager->saveArena = NULL;
+    UnloadTerrainOverlay(&manager->overlay);
+    UnloadEntityGrid(&manager->grid);
+    free(manager->colliders);
+    free(manager->colliderStart);
+    free(manager->pushX);
+    free(manager->pushY);
+    free(manager->slotIndex);
+    free(manager->slotGeneration);
+    free(manager->denseSlot);
+    manager->count = 0;
+    manager->capacity = 0;
+}
+
+int GetEntityIndex(const EntityManager *manager, EntityHandle handle) {
+    if (handle.slot >= (uint32_t)manager->capacity) return -1;
+    if (handle.generation == 0 || manager->slotGeneration[handle.slot] != handle.generation) return -1;
+    return manager->slotIndex[handle.slot];
+}
+
+EntityHandle GetEntityHandle(const EntityManager *manager, int index) {
+    if (index < 0 || index >= manager->count) return ENTITY_NULL;
+    uint32_t slot = manager->denseSlot[index];
+    return (EntityHandle){ slot, manager->slotGeneration[slot] };
+}
+
+// Copies every per-entity field from src to dst
+static void MoveEntity(EntityManager *manager, int dst, int src) {
+    manager->x[dst] = manager->x[src];
+    manager->y[dst] = manager->y[src];
+    manager->prevX[dst] = manager->prevX[src];
+    manager->prevY[dst] = manager->prevY[src];
+    manager->dx[dst] = manager->dx[src];
+    manager->dy[dst] = manager->dy[src];
+    manager->facing[dst] = manager->facing[src];
+    manager->type[dst] = manager->type[src];
+    manager->rngKey[dst] = manager->rngKey[src];
+    manager->rngCounter[dst] = manager->rngCounter[src];
+    manager->model[dst] = manager->model[src];
+    manager->width[dst] = manager->width[src];
+    manager->length[dst] = manager->length[src];
+    manager->z_offset[dst] = manager->z_offset[src];
+    manager->speed[dst] = manager->speed[src];
+    manager->paint[dst] = manager->paint[src];
+    manager->saveOffset[dst] = manager->saveOffset[src];
+
+    manager->denseSlot[dst] = manager->denseSlot[src];
+    manager->slotIndex[manager->denseSlot[dst]] = dst;
+}
+
+bool RemoveEntity(EntityManager *manager, EntityHandle handle) {
+    int i = GetEntityIndex(manager, handle);
+    if (i < 0) return false;
+
+    // Keep the arrays packed: the last entity fills the hole
+    int last = manager->count - 1;
+    if (i != last) MoveEntity(manager, i, last);
+    manager->count--;
+
+    // Invalidate outstanding handles and recycle the slot
+    uint32_t slot = handle.slot;
+    EntityGridRemove(&manager->grid, (int)slot);
+    if (++manager->slotGeneration[slot] == 0) manager->slotGeneration[slot] = 1;
+    manager->slotIndex[slot] = manager->freeSlot;
+    manager->freeSlot = (int)slot;
+    return true;
+}
+
+EntityHandle AddEntityFromModel(EntityManager *manager, EntityType type, float x, float y, const VoxelModel *model) {
     // If no free slot, fail safely
-    if (slot == -1) return;
+    if (manager->freeSlot < 0) return ENTITY_NULL;
 
-    Entity *e = &manager->list[slot];
-    e->active = true;
-    e->type = type;
-    e->x = x;
-    e->y = y;
-    e->facing = 0; 
-    e->model = model;
+    uint32_t slot = (uint32_t)manager->freeSlot;
+    manager->freeSlot = manager->slotIndex[slot];
 
-    if (e->model) {
-        e->width = model->width;
-        e->length = model->length;
-        e->height_shape = 0; // Driven by model
-    }
+    // Live entities stay packed, the new one goes at the end
+    int i = manager->count++;
+    manager->slotIndex[slot] = i;
+    manager->denseSlot[i] = slot;
+    manager->type[i] = (unsigned char)type;
+    manager->x[i] = x;
+    manager->y[i] = y;
+    manager->prevX[i] = x;
+    manager->prevY[i] = y;
+    manager->facing[i] = 0;
+    manager->model[i] = model;
+    manager->rngKey[i] = RandomHash(RandomKey(gameSettings.seed, RANDOM_STREAM_ENTITY), manager->spawnSerial++);
+    manager->rngCounter[i] = 0;
+    manager->paint[i] = (EntityRect){0};
+
+    EntityGridInsert(&manager->grid, (int)slot, x, y);
+
+    const VoxelModel *shape = model ? model : &fallbackModels[type];
+    manager->width[i] = (unsigned short)shape->width;
+    manager->length[i] = (unsigned short)shape->length;
 
     if (type == ENTITY_SHIP) {
-        if (!e->model) {
-            e->width = 8;
-            e->length = 20;
-            e->height_shape = 8; 
-            e->color = (Color){100, 100, 110, 255};
-        }
-        e->z_offset = LEVEL_WATER;
-        
-        e->speed = (float)GetRandomValue(10, 30); // Random speed
-        float angle = (float)GetRandomValue(0, 628) / 100.0f; // 0 to 2PI
-        e->dx = cosf(angle) * e->speed;
-        e->dy = sinf(angle) * e->speed;
+        manager->z_offset[i] = LEVEL_WATER;
+
+        manager->speed[i] = (float)EntityRandom(manager, i, 10, 30); // Random speed
+        float angle = (float)EntityRandom(manager, i, 0, 628) / 100.0f; // 0 to 2PI
+        manager->dx[i] = cosf(angle) * manager->speed[i];
+        manager->dy[i] = sinf(angle) * manager->speed[i];
 
         // Set initial facing
-        if (fabsf(e->dx) > fabsf(e->dy)) e->facing = (e->dx > 0) ? 0 : 2;
-        else e->facing = (e->dy > 0) ? 1 : 3;
+        manager->facing[i] = FacingFromVelocity(manager->dx[i], manager->dy[i]);
     }
     else if (type == ENTITY_UNIT) {
-        if (!e->model) {
-            e->width = 2;
-            e->length = 2;
-            e->height_shape = 4;
-            e->color = BLACK;
-        }
-        e->z_offset = 0;
-        
-        e->speed = (float)GetRandomValue(20, 40);
-        float angle = (float)GetRandomValue(0, 628) / 100.0f;
-        e->dx = cosf(angle) * e->speed;
-        e->dy = sinf(angle) * e->speed;
+        manager->z_offset[i] = 0;
+
+        manager->speed[i] = (float)EntityRandom(manager, i, 20, 40);
+        float angle = (float)EntityRandom(manager, i, 0, 628) / 100.0f;
+        manager->dx[i] = cosf(angle) * manager->speed[i];
+        manager->dy[i] = sinf(angle) * manager->speed[i];
 
         // Set initial facing
-        if (fabsf(e->dx) > fabsf(e->dy)) e->facing = (e->dx > 0) ? 0 : 2;
-        else e->facing = (e->dy > 0) ? 1 : 3;
+        manager->facing[i] = FacingFromVelocity(manager->dx[i], manager->dy[i]);
     }
     else if (type == ENTITY_BUILDING) {
-        if (!e->model) {
-            e->width = 8;
-            e->length = 8;
-            e->height_shape = 8;
-            e->color = BROWN;
-        }
-        e->z_offset = 0;
-        
-        e->speed = 0;
-        e->dx = 0;
-        e->dy = 0;
+        manager->z_offset[i] = 0;
+
+        manager->speed[i] = 0;
+        manager->dx[i] = 0;
+        manager->dy[i] = 0;
     }
-    
-    manager->count++;
+
+    return (EntityHandle){ slot, manager->slotGeneration[slot] };
 }
 
-void AddEntity(EntityManager *manager, EntityType type, float x, float y) {
-    AddEntityFromModel(manager, type, x, y, GetRandomModel(type));
+EntityHandle AddEntity(EntityManager *manager, EntityType type, float x, float y) {
+    uint32_t pick = RandomHash(RandomKey(gameSettings.seed, RANDOM_STREAM_MODEL), manager->spawnSerial);
+    return AddEntityFromModel(manager, type, x, y, GetRandomModel(type, pick));
 }
 
-void UpdateEntities(EntityManager *manager, float deltaTime, const Terrain *terrain) {
-    for(int i=0; i<MAX_ENTITIES; i++) {
-        Entity *e = &manager->list[i];
-        if (!e->active) continue;
-
-        if (e->type == ENTITY_SHIP) {
-             float nextX = e->x + e->dx * deltaTime;
-             float nextY = e->y + e->dy * deltaTime;
-             
-             // Map bounds wrapping
-             if (nextX < 0) nextX += gameSettings.mapSize;
-             if (nextX >= gameSettings.mapSize) nextX -= gameSettings.mapSize;
-             if (nextY < 0) nextY += gameSettings.mapSize;
-             if (nextY >= gameSettings.mapSize) nextY -= gameSettings.mapSize;
-
-             // Check collision with terrain
-             int mapX = (int)nextX & (gameSettings.mapSize - 1);
-             int mapY = (int)nextY & (gameSettings.mapSize - 1);
-             int index = mapY * gameSettings.mapSize + mapX;
-             
-             // Water level is LEVEL_WATER. If terrain is higher, it's land.
-             // We allow a small tolerance for shorelines
-             if (terrain->heightmapRaw[index] > LEVEL_WATER + 2) {
-                 // Bounce: simplistic reflection
-                 e->dx = -e->dx;
-                 e->dy = -e->dy;
-                 
-                 // Add some randomness
-                 float noise = ((float)GetRandomValue(-100, 100) / 100.0f) * 0.5f; 
-                 e->dx += noise;
-                 e->dy += noise;
-             } else {
-                 e->x = nextX;
-                 e->y = nextY;
-             }
-
-             // Update facing
-             if (fabsf(e->dx) > fabsf(e->dy)) e->facing = (e->dx > 0) ? 0 : 2;
-             else e->facing = (e->dy > 0) ? 1 : 3;
-        }
-        else if (e->type == ENTITY_UNIT) {
-             float nextX = e->x + e->dx * deltaTime;
-             float nextY = e->y + e->dy * deltaTime;
-             
-             // Map bounds wrapping
-             if (nextX < 0) nextX += gameSettings.mapSize;
-             if (nextX >= gameSettings.mapSize) nextX -= gameSettings.mapSize;
-             if (nextY < 0) nextY += gameSettings.mapSize;
-             if (nextY >= gameSettings.mapSize) nextY -= gameSettings.mapSize;
-
-             // Check collision with terrain
-             int mapX = (int)nextX & (gameSettings.mapSize - 1);
-             int mapY = (int)nextY & (gameSettings.mapSize - 1);
-             int index = mapY * gameSettings.mapSize + mapX;
-             
-             // Land units stay on land. Bounce on water.
-             if (terrain->heightmapRaw[index] <= LEVEL_WATER + 2) {
-                 e->dx = -e->dx;
-                 e->dy = -e->dy;
-                 
-                 float noise = ((float)GetRandomValue(-100, 100) / 100.0f) * 0.5f; 
-                 e->dx += noise;
-                 e->dy += noise;
-             } else {
-                 e->x = nextX;
-                 e->y = nextY;
-             }
-
-             // Update facing
-             if (fabsf(e->dx) > fabsf(e->dy)) e->facing = (e->dx > 0) ? 0 : 2;
-             else e->facing = (e->dy > 0) ? 1 : 3;
+// Signed offset from a to b along one axis, taking the shorter way
+// around the wrapping map
+static float WrappedDelta(float a, float b, float mapSize) {
+    // Positions are kept in [0, mapSize), fmodf only for outside callers
+    float d = b - a;
+    if (d >= mapSize || d <= -mapSize) d = fmodf(d, mapSize);
+    if (d > mapSize * 0.5f) d -= mapSize;
+    else if (d < -mapSize * 0.5f) d += mapSize;
+    return d;
+}
+
+// Range of grid cells along one axis covering [from, to] map texels,
+// capped at one full row so wrapped ranges do not visit a cell twice
+static void GridCellSpan(const EntityGrid *grid, float from, float to, int *first, int *count) {
+    *first = (int)floorf(from) >> ENTITY_GRID_CELL_SHIFT;
+    *count = ((int)floorf(to) >> ENTITY_GRID_CELL_SHIFT) - *first + 1;
+    if (*count > EntityGridCellsPerRow(grid)) *count = EntityGridCellsPerRow(grid);
+}
+
+int QueryEntitiesInRect(const EntityManager *manager, EntityRect rect, EntityHandle *results, int maxResults) {
+    const EntityGrid *grid = &manager->grid;
+    float mapSize = (float)gameSettings.mapSize;
+    int found = 0;
+    if (rect.w <= 0 || rect.h <= 0) return 0;
+
+    int cx0, cy0, cw, ch;
+    GridCellSpan(grid, (float)rect.x, (float)(rect.x + rect.w - 1), &cx0, &cw);
+    GridCellSpan(grid, (float)rect.y, (float)(rect.y + rect.h - 1), &cy0, &ch);
+
+    for (int cy = cy0; cy < cy0 + ch; cy++) {
+        for (int cx = cx0; cx < cx0 + cw; cx++) {
+            for (int s = grid->cellHead[EntityGridCell(grid, cx, cy)]; s >= 0; s = grid->next[s]) {
+                int i = manager->slotIndex[s];
+                // Offset into the rect, wrapped into [0, mapSize)
+                float ox = fmodf(manager->x[i] - rect.x, mapSize);
+                float oy = fmodf(manager->y[i] - rect.y, mapSize);
+                if (ox < 0) ox += mapSize;
+                if (oy < 0) oy += mapSize;
+                if (ox >= rect.w || oy >= rect.h) continue;
+
+                if (found < maxResults) results[found] = GetEntityHandle(manager, i);
+                found++;
+            }
         }
     }
+    return found;
 }
 
-void PaintEntities(EntityManager *manager, Terrain *terrain) {
-    for(int i=0; i<MAX_ENTITIES; i++) {
-        Entity *e = &manager->list[i];
-        if (!e->active) continue;
+int QueryEntitiesInRadius(const EntityManager *manager, float x, float y, float radius, EntityHandle *results, int maxResults) {
+    const EntityGrid *grid = &manager->grid;
+    float mapSize = (float)gameSettings.mapSize;
+    int found = 0;
 
-        // Default dimensions (Vertical / Up / Down)
-        int drawW = e->width;
-        int drawH = e->length;
+    int cx0, cy0, cw, ch;
+    GridCellSpan(grid, x - radius, x + radius, &cx0, &cw);
+    GridCellSpan(grid, y - radius, y + radius, &cy0, &ch);
 
-        // Swap dimensions for Horizontal facings (Right / Left)
-        if (e->facing == 0 || e->facing == 2) {
-            drawW = e->length;
-            drawH = e->width;
+    for (int cy = cy0; cy < cy0 + ch; cy++) {
+        for (int cx = cx0; cx < cx0 + cw; cx++) {
+            for (int s = grid->cellHead[EntityGridCell(grid, cx, cy)]; s >= 0; s = grid->next[s]) {
+                int i = manager->slotIndex[s];
+                float dx = WrappedDelta(x, manager->x[i], mapSize);
+                float dy = WrappedDelta(y, manager->y[i], mapSize);
+                if (dx * dx + dy * dy > radius * radius) continue;
+
+                if (found < maxResults) results[found] = GetEntityHandle(manager, i);
+                found++;
+            }
         }
+    }
+    return found;
+}
 
-        int px = (int)e->x - drawW/2;
-        int py = (int)e->y - drawH/2;
-        
-        // Store bounds for Restore pass
-        e->paint_x = px;
-        e->paint_y = py;
-        e->paint_w = drawW;
-        e->paint_h = drawH;
+EntityHandle FindNearestEntity(const EntityManager *manager, float x, float y, float maxDistance) {
+    const EntityGrid *grid = &manager->grid;
+    float mapSize = (float)gameSettings.mapSize;
+    float cellSize = (float)(1 << ENTITY_GRID_CELL_SHIFT);
 
-        int bufIndex = 0;
-        for(int dy = 0; dy < drawH; dy++) {
-            for(int dx = 0; dx < drawW; dx++) {
-                // Handle map wrapping
-                int mx = (px + dx) & (gameSettings.mapSize - 1);
-                int my = (py + dy) & (gameSettings.mapSize - 1);
-                int mapIndex = my * gameSettings.mapSize + mx;
-                
-                if (bufIndex >= MAX_ENTITY_SIZE * MAX_ENTITY_SIZE) break;
-
-                // 1. Save background
-                e->savedHeights[bufIndex] = terrain->heightmapRaw[mapIndex];
-                e->savedColors[bufIndex] = terrain->colormapData[mapIndex];
-
-                // 2. Paint Entity
-                // Only paint if the entity is "above" the existing terrain
-                unsigned char currentH = terrain->heightmapRaw[mapIndex];
-                
-                unsigned char baseH = (e->type == ENTITY_SHIP) ? (unsigned char)e->z_offset : currentH;
-                unsigned char entityH = 0;
-                Color entityC = BLANK;
-                bool draw = false;
-
-                // Calculate Model Coordinates (modX, modY) based on facing
-                // Assume Default Model Orientation is UP (Facing 3)
-                int modX = dx;
-                int modY = dy;
-
-                if (e->facing == 0) { // Right
-                    // 90 Deg Clockwise from Up
-                    // modX maps to dy
-                    // modY maps to reversed dx
-                    modX = dy;
-                    modY = e->length - 1 - dx;
-                } 
-                else if (e->facing == 1) { // Down
-                    // 180 Deg
-                    modX = e->width - 1 - dx;
-                    modY = e->length - 1 - dy;
-                }
-                else if (e->facing == 2) { // Left
-                    // 270 Deg Clockwise (90 CCW) from Up
-                    // modX maps to reversed dy
-                    // modY maps to dx
-                    modX = e->width - 1 - dy;
-                    modY = dx;
-                }
-                else { // Up (3)
-                    // Identity
-                    modX = dx;
-                    modY = dy;
-                }
+    int centerX = (int)floorf(x) >> ENTITY_GRID_CELL_SHIFT;
+    int centerY = (int)floorf(y) >> ENTITY_GRID_CELL_SHIFT;
+    int maxRing = (int)ceilf(maxDistance / cellSize);
+    if (maxRing > EntityGridCellsPerRow(grid) / 2) maxRing = EntityGridCellsPerRow(grid) / 2;
+
+    int best = -1;
+    float bestDist2 = maxDistance * maxDistance;
 
-                if (e->model) {
-                    if (modX >= 0 && modX < e->width && modY >= 0 && modY < e->length) {
-                        int idx = modY * MAX_ENTITY_SIZE + modX;
-                        unsigned char h = e->model->heights[idx];
-                        if (h > 0) {
-                            entityH = baseH + h;
-                            entityC = e->model->colors[idx];
-                            draw = true;
-                        }
+    // Rings of cells around the center cell. Everything in ring k + 1 is at
+    // least k cells away, so the search stops once the best match is closer.
+    for (int ring = 0; ring <= maxRing; ring++) {
+        for (int cy = centerY - ring; cy <= centerY + ring; cy++) {
+            bool edgeRow = (cy == centerY - ring || cy == centerY + ring);
+            int stepX = edgeRow ? 1 : 2 * ring;
+            for (int cx = centerX - ring; cx <= centerX + ring; cx += stepX) {
+                for (int s = grid->cellHead[EntityGridCell(grid, cx, cy)]; s >= 0; s = grid->next[s]) {
+                    int i = manager->slotIndex[s];
+                    float dx = WrappedDelta(x, manager->x[i], mapSize);
+                    float dy = WrappedDelta(y, manager->y[i], mapSize);
+                    float dist2 = dx * dx + dy * dy;
+                    if (dist2 <= bestDist2) {
+                        bestDist2 = dist2;
+                        best = i;
                     }
+                }
+            }
+        }
+
+        float cleared = ring * cellSize;
+        if (best >= 0 && bestDist2 <= cleared * cleared) break;
+    }
+
+    return (best >= 0) ? GetEntityHandle(manager, best) : ENTITY_NULL;
+}
+
+void SpawnEntitySmart(EntityManager *manager, const Terrain *terrain, EntityType type, int count) {
+    // Keyed by the spawn serial too, so repeated calls pick new spots
+    uint32_t key = RandomHash(RandomKey(gameSettings.seed, RANDOM_STREAM_SPAWN + (uint32_t)type), manager->spawnSerial);
+    int spawned = 0;
+    int attempts = 0;
+    while(spawned < count && attempts < count * 1000) {
+        attempts++;
+        int x = RandomRange(key, 2 * attempts, 0, gameSettings.mapSize - 1);
+        int y = RandomRange(key, 2 * attempts + 1, 0, gameSettings.mapSize - 1);
+        unsigned char h = TexelHeight(terrain->texels[TerrainIndex(terrain, x, y)]);
+
+        bool valid = false;
+        if (type == ENTITY_SHIP) {
+            if (h <= LEVEL_WATER) valid = true;
+        } else if (type == ENTITY_UNIT || type == ENTITY_BUILDING) {
+            if (h > LEVEL_WATER + 2 && h < LEVEL_SAND) valid = true;
+        }
+
+        if (valid) {
+            EntityHandle handle = AddEntity(manager, type, (float)x, (float)y);
+            if (handle.generation == 0) break; // Manager full
+            spawned++;
+        }
+    }
+}
+
+// Whether terrain height h stops an entity of this type. Water level is
+// LEVEL_WATER; if terrain is higher, it's land. We allow a small tolerance
+// for shorelines. Ships bounce on land, land units bounce on water.
+static bool TerrainBlocks(EntityType type, int h) {
+    return (type == ENTITY_SHIP) ? (h > LEVEL_WATER + 2) : (h <= LEVEL_WATER + 2);
+}
+
+// Half extents of entity i's footprint, horizontal facings (Right / Left)
+// swap width and length
+static void EntityHalfExtents(const EntityManager *manager, int i, float *halfX, float *halfY) {
+    bool horizontal = (manager->facing[i] == 0 || manager->facing[i] == 2);
+    *halfX = (horizontal ? manager->length[i] : manager->width[i]) * 0.5f;
+    *halfY = (horizontal ? manager->width[i] : manager->length[i]) * 0.5f;
+}
+
+// Copies every footprint into colliders, grouped by grid cell (counting
+// sort), so the narrow phase scans contiguous memory instead of gathering
+// from the entity arrays. Cells come from the positions, the grid itself
+// is only brought up to date at the end of the step.
+static void BuildColliders(EntityManager *manager) {
+    const EntityGrid *grid = &manager->grid;
+    int cellCount = EntityGridCellsPerRow(grid) * EntityGridCellsPerRow(grid);
+    int *start = manager->colliderStart;
+
+    manager->colliderMaxHalf = 0.0f;
+    memset(start, 0, cellCount * sizeof(int));
+    for (int i = 0; i < manager->count; i++) {
+        start[EntityGridCellAt(grid, manager->x[i], manager->y[i])]++;
+    }
+    for (int c = 1; c < cellCount; c++) start[c] += start[c - 1];
+    start[cellCount] = manager->count;
+
+    // start[c] is the end of cell c now. Filling back to front moves it to
+    // the cell's first collider and keeps entity order within the cell.
+    for (int i = manager->count - 1; i >= 0; i--) {
+        int k = --start[EntityGridCellAt(grid, manager->x[i], manager->y[i])];
+        EntityCollider *col = &manager->colliders[k];
+        col->x = manager->x[i];
+        col->y = manager->y[i];
+        EntityHalfExtents(manager, i, &col->halfX, &col->halfY);
+        // Moving pairs split the separation, buildings do not give way
+        col->share = (manager->type[i] == ENTITY_BUILDING) ? 1.0f : 0.5f;
+        col->index = i;
+
+        float half = (col->halfX > col->halfY) ? col->halfX : col->halfY;
+        if (half > manager->colliderMaxHalf) manager->colliderMaxHalf = half;
+    }
+}
+
+// Narrow phase for moving entity i against every footprint the grid finds
+// near it. Only reads the collider snapshot, so every entity is resolved
+// against the same positions (and in any order): the separation lands in
+// pushX/pushY and is applied afterwards. Velocity components heading into
+// an obstacle are reflected.
+static void CollideEntity(EntityManager *manager, int i, float mapSize) {
+    const EntityGrid *grid = &manager->grid;
+    const EntityCollider *colliders = manager->colliders;
+    const int *start = manager->colliderStart;
+    float x = manager->x[i];
+    float y = manager->y[i];
+    float halfX, halfY;
+    EntityHalfExtents(manager, i, &halfX, &halfY);
+
+    // Broad phase: cells that can hold the center of an overlapping
+    // footprint (none is larger than the largest in the snapshot)
+    float reachX = halfX + manager->colliderMaxHalf;
+    float reachY = halfY + manager->colliderMaxHalf;
+    int cx0, cy0, cw, ch;
+    GridCellSpan(grid, x - reachX, x + reachX, &cx0, &cw);
+    GridCellSpan(grid, y - reachY, y + reachY, &cy0, &ch);
+
+    // Cells of a row are consecutive in the snapshot, so each row is one
+    // range of colliders (two where the span wraps the map edge)
+    int rowCells = EntityGridCellsPerRow(grid);
+    int firstX = cx0 & grid->cellMask;
+    int endX = (firstX + cw < rowCells) ? firstX + cw : rowCells;
+    int wrapX = (firstX + cw > rowCells) ? firstX + cw - rowCells : 0;
+    int spans[2][2] = { { firstX, endX }, { 0, wrapX } };
+
+    float pushX = 0.0f, pushY = 0.0f;
+    float velX = manager->dx[i], velY = manager->dy[i];
+
+    for (int cy = cy0; cy < cy0 + ch; cy++) {
+        int row = EntityGridCell(grid, 0, cy);
+        for (int span = 0; span < 2; span++) {
+            int kEnd = start[row + spans[span][1]];
+            for (int k = start[row + spans[span][0]]; k < kEnd; k++) {
+                const EntityCollider *other = &colliders[k];
+                float dx = WrappedDelta(x, other->x, mapSize);
+                float dy = WrappedDelta(y, other->y, mapSize);
+                float overlapX = halfX + other->halfX - fabsf(dx);
+                float overlapY = halfY + other->halfY - fabsf(dy);
+                if (overlapX <= 0.0f || overlapY <= 0.0f || other->index == i) continue;
+
+                // Separate along the axis of least penetration
+                if (overlapX < overlapY) {
+                    float dir = (dx > 0.0f) ? -1.0f : 1.0f;
+                    pushX += dir * overlapX * other->share;
+                    if (velX * dir < 0.0f) velX = -velX;
                 } else {
-                    // Procedural Fallback
-                    // We use drawW/drawH here for the boundary check
-                    entityH = baseH + (unsigned char)e->height_shape;
-                    if (dx == 0 || dx == drawW-1 || dy == 0 || dy == drawH-1) {
-                         entityC = (Color){e->color.r/2, e->color.g/2, e->color.b/2, 255};
-                    } else {
-                         entityC = e->color;
-                    }
-                    
-                    // Simple procedural detail logic (not rotated fully, just simple shapes)
-                    if (e->type == ENTITY_SHIP) {
-                        // Just draw a "cabin" in the middle-ish
-                        if (dx >= drawW/4 && dx <= drawW*3/4 && dy >= drawH/4 && dy <= drawH/2) {
-                            entityH += 4;
-                            entityC = RAYWHITE;
-                        }
-                    }
-                    else if (e->type == ENTITY_BUILDING) {
-                        int cx = drawW / 2;
-                        int cy = drawH / 2;
-                        int distX = abs(dx - cx);
-                        int distY = abs(dy - cy);
-                        int dist = (distX > distY) ? distX : distY;
-                        int roofHeight = (cx - dist) * 2;
-                        if (roofHeight > 0) {
-                            entityH += roofHeight;
-                            entityC = (Color){160, 82, 45, 255};
-                        }
-                    }
-                    draw = true;
+                    float dir = (dy > 0.0f) ? -1.0f : 1.0f;
+                    pushY += dir * overlapY * other->share;
+                    if (velY * dir < 0.0f) velY = -velY;
                 }
+            }
+        }
+    }
+
+    manager->dx[i] = velX;
+    manager->dy[i] = velY;
+    manager->pushX[i] = pushX;
+    manager->pushY[i] = pushY;
+}
+
+typedef struct {
+    EntityManager *manager;
+    const Terrain *terrain;
+    float mapSize;
+} SimJob;
+
+static bool IsMoving(const EntityManager *manager, int i) {
+    return manager->type[i] == ENTITY_SHIP || manager->type[i] == ENTITY_UNIT;
+}
+
+// Step phase 1: move along the velocity, bounce off blocking terrain.
+// Every phase only writes the entities of its own range.
+//
+// Ships and units share one branch-free kernel: each strip of
+// ENTITY_SIMD_STRIP entities is copied into local arrays, so the passes
+// below are plain fixed-stride loops over non-aliasing data that the
+// compiler vectorizes for the target (-march). Type differences and
+// bounces are per-lane selects; only the terrain gather is scalar.
+static void MoveEntitiesJob(void *data, int start, int end) {
+    SimJob *job = (SimJob*)data;
+    EntityManager *manager = job->manager;
+    const Terrain *terrain = job->terrain;
+    float mapSize = job->mapSize;
+
+    float x[ENTITY_SIMD_STRIP], y[ENTITY_SIMD_STRIP];
+    float dx[ENTITY_SIMD_STRIP], dy[ENTITY_SIMD_STRIP];
+    float nextX[ENTITY_SIMD_STRIP], nextY[ENTITY_SIMD_STRIP];
+    int index[ENTITY_SIMD_STRIP];
+    int height[ENTITY_SIMD_STRIP];
+
+    for(int base=start; base<end; base+=ENTITY_SIMD_STRIP) {
+        int n = (end - base < ENTITY_SIMD_STRIP) ? end - base : ENTITY_SIMD_STRIP;
+        size_t bytes = (size_t)n * sizeof(float);
+
+        memcpy(x, manager->x + base, bytes);
+        memcpy(y, manager->y + base, bytes);
+        memcpy(dx, manager->dx + base, bytes);
+        memcpy(dy, manager->dy + base, bytes);
+        memcpy(manager->prevX + base, x, bytes);
+        memcpy(manager->prevY + base, y, bytes);
+
+        // Integrate, wrap onto the map, locate the texel underneath
+        for(int k=0; k<n; k++) {
+            float nx = x[k] + dx[k] * SIM_STEP;
+            float ny = y[k] + dy[k] * SIM_STEP;
+            nx += (nx < 0.0f) ? mapSize : 0.0f;
+            nx -= (nx >= mapSize) ? mapSize : 0.0f;
+            ny += (ny < 0.0f) ? mapSize : 0.0f;
+            ny -= (ny >= mapSize) ? mapSize : 0.0f;
+            nextX[k] = nx;
+            nextY[k] = ny;
+            index[k] = TerrainIndexWrapped(terrain, (int)nx, (int)ny);
+        }
+
+        for(int k=0; k<n; k++) {
+            height[k] = TexelHeight(terrain->texels[index[k]]);
+        }
+
+        // Bounce (reflect plus noise from the entity's own stream) where
+        // the terrain blocks, else take the step. Buildings keep still.
+        const unsigned char *types = manager->type + base;
+        const uint32_t *keys = manager->rngKey + base;
+        uint32_t *counters = manager->rngCounter + base;
+        for(int k=0; k<n; k++) {
+            int type = types[k];
+            int moving = (type == ENTITY_SHIP) | (type == ENTITY_UNIT);
+            // TerrainBlocks as a mask: ships need water, units land
+            int water = (height[k] <= LEVEL_WATER + 2);
+            int bounce = moving & ((type == ENTITY_SHIP) ^ water);
+            int step = moving & !bounce;
+
+            uint32_t counter = counters[k];
+            float noise = ((float)RandomRange(keys[k], counter, -100, 100) / 100.0f) * 0.5f;
+            counters[k] = counter + (uint32_t)bounce;
+
+            float vx = dx[k];
+            float vy = dy[k];
+            dx[k] = bounce ? noise - vx : vx;
+            dy[k] = bounce ? noise - vy : vy;
+            x[k] = step ? nextX[k] : x[k];
+            y[k] = step ? nextY[k] : y[k];
+        }
+
+        memcpy(manager->x + base, x, bytes);
+        memcpy(manager->y + base, y, bytes);
+        memcpy(manager->dx + base, dx, bytes);
+        memcpy(manager->dy + base, dy, bytes);
+    }
+}
+
+// Step phase 2: entity vs entity, against the collider snapshot
+static void CollideEntitiesJob(void *data, int start, int end) {
+    SimJob *job = (SimJob*)data;
+    EntityManager *manager = job->manager;
+    for(int i=start; i<end; i++) {
+        if (IsMoving(manager, i)) {
+            CollideEntity(manager, i, job->mapSize);
+        } else {
+            manager->pushX[i] = 0.0f;
+            manager->pushY[i] = 0.0f;
+        }
+    }
+}
+
+// Step phase 3: apply the separation and update facings
+static void ResolveEntitiesJob(void *data, int start, int end) {
+    SimJob *job = (SimJob*)data;
+    EntityManager *manager = job->manager;
+    const Terrain *terrain = job->terrain;
+    float mapSize = job->mapSize;
+
+    for(int i=start; i<end; i++) {
+        if (manager->pushX[i] == 0.0f && manager->pushY[i] == 0.0f) continue;
+        EntityType type = (EntityType)manager->type[i];
+
+        float nextX = fmodf(manager->x[i] + manager->pushX[i] + mapSize, mapSize);
+        float nextY = fmodf(manager->y[i] + manager->pushY[i] + mapSize, mapSize);
+
+        // Never shove an entity onto terrain it cannot enter
+        int index = TerrainIndexWrapped(terrain, (int)nextX, (int)nextY);
+        if (!TerrainBlocks(type, TexelHeight(terrain->texels[index]))) {
+            manager->x[i] = nextX;
+            manager->y[i] = nextY;
+        }
+    }
 
-                if (draw && entityH >= currentH) {
-                    terrain->heightmapRaw[mapIndex] = entityH;
-                    terrain->colormapData[mapIndex] = entityC;
+    // Update facing, branch-free like the movement kernel
+    const unsigned char *types = manager->type;
+    const float *dx = manager->dx;
+    const float *dy = manager->dy;
+    unsigned char *facings = manager->facing;
+    for(int i=start; i<end; i++) {
+        int moving = (types[i] == ENTITY_SHIP) | (types[i] == ENTITY_UNIT);
+        int horizontal = fabsf(dx[i]) > fabsf(dy[i]);
+        int facing = horizontal ? ((dx[i] > 0) ? 0 : 2) : ((dy[i] > 0) ? 1 : 3);
+        facings[i] = moving ? (unsigned char)facing : facings[i];
+    }
+}
+
+// One fixed step. Parallel phases are separated by the serial collider
+// snapshot and the grid update (the grid's lists are shared).
+static void StepEntities(EntityManager *manager, const Terrain *terrain) {
+    SimJob job = { manager, terrain, (float)gameSettings.mapSize };
+
+    RunParallel(MoveEntitiesJob, &job, manager->count, ENTITY_JOB_BATCH);
+    BuildColliders(manager);
+    RunParallel(CollideEntitiesJob, &job, manager->count, ENTITY_JOB_BATCH);
+    RunParallel(ResolveEntitiesJob, &job, manager->count, ENTITY_JOB_BATCH);
+
+    for(int i=0; i<manager->count; i++) {
+        if (IsMoving(manager, i)) EntityGridMove(&manager->grid, (int)manager->denseSlot[i], manager->x[i], manager->y[i]);
+    }
+}
+
+void UpdateEntities(EntityManager *manager, float deltaTime, const Terrain *terrain) {
+    manager->simAccumulator += deltaTime;
+
+    int steps = 0;
+    while (manager->simAccumulator >= SIM_STEP && steps < MAX_SIM_STEPS_PER_FRAME) {
+        StepEntities(manager, terrain);
+        manager->simAccumulator -= SIM_STEP;
+        steps++;
+    }
+    // After a long stall, drop the backlog rather than catch up for frames
+    if (manager->simAccumulator >= SIM_STEP) manager->simAccumulator = 0.0f;
+
+    manager->simAlpha = manager->simAccumulator / SIM_STEP;
+}
+
+// Bump-allocates the save buffer for entity i. Offsets rather than pointers
+// are stored, so growing the arena mid-frame is safe.
+static TerrainTexel *AllocSaveTexels(EntityManager *manager, int i, size_t texels) {
+    size_t needed = manager->saveArenaUsed + texels;
+    if (needed > manager->saveArenaCapacity) {
+        size_t capacity = manager->saveArenaCapacity * 2;
+        while (capacity < needed) capacity *= 2;
+        manager->saveArena = (TerrainTexel*)realloc(manager->saveArena, capacity * sizeof(TerrainTexel));
+        manager->saveArenaCapacity = capacity;
+    }
+
+    manager->saveOffset[i] = manager->saveArenaUsed;
+    manager->saveArenaUsed = needed;
+    return manager->saveArena + manager->saveOffset[i];
+}
+
+// The area DrawVertexSpace samples: a 90 degree wedge from the camera,
+// drawDistance deep, centered on the view direction.
+typedef struct {
+    float camX, camY;
+    float forwardX, forwardY;
+    float rightX, rightY;
+    float depth;
+    float mapSize;
+} ViewWedge;
+
+static ViewWedge MakeViewWedge(const EngineState *view) {
+    return (ViewWedge){
+        .camX = view->camera_x, .camY = view->camera_y,
+        .forwardX = -view->sinphi, .forwardY = -view->cosphi,
+        .rightX = view->cosphi, .rightY = -view->sinphi,
+        .depth = view->drawDistance,
+        .mapSize = (float)gameSettings.mapSize
+    };
+}
+
+// Whether any part of a footprint of the given radius around (x, y) can be
+// sampled. The renderer wraps map coordinates, so every repeat of the map
+// within view distance counts (small maps repeat several times).
+static bool InViewWedge(const ViewWedge *w, float x, float y, float radius) {
+    float reach = w->depth + radius;
+    float relX = fmodf(x - w->camX, w->mapSize);
+    float relY = fmodf(y - w->camY, w->mapSize);
+
+    for (float ox = relX - ceilf((reach + relX) / w->mapSize) * w->mapSize; ox <= reach; ox += w->mapSize) {
+        if (ox < -reach) continue;
+        for (float oy = relY - ceilf((reach + relY) / w->mapSize) * w->mapSize; oy <= reach; oy += w->mapSize) {
+            if (oy < -reach) continue;
+
+            float depth = ox * w->forwardX + oy * w->forwardY;
+            float lateral = ox * w->rightX + oy * w->rightY;
+            // 45 degree edges: a circle touches the wedge while its center
+            // is within radius * sqrt(2) of |lateral| = depth
+            if (depth >= -radius && depth <= reach && fabsf(lateral) <= depth + radius * 1.4142136f) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Overlay tiles never straddle terrain tiles, so a run inside one overlay
+// tile row is contiguous in both
+#if OVERLAY_TILE_SHIFT > TERRAIN_TILE_SHIFT
+#error "OVERLAY_TILE must not exceed TERRAIN_TILE"
+#endif
+
+// Paints one run of a variant row. under is the terrain, dst the overlay or
+// the terrain itself; texels already in dst (earlier entities) are painted
+// over. Non-ships sit on what they cover (followMask 0xFF), ships on baseH.
+// Returns the highest height painted, for the renderer's occlusion bound.
+static int BlitModelRun(TerrainTexel *dst, const TerrainTexel *under, const unsigned char *heights, const unsigned char *colors,
+                        int count, unsigned char baseH, unsigned char followMask) {
+    int top = 0;
+    for (int k = 0; k < count; k++) {
+        TerrainTexel current = dst[k] ? dst[k] : under[k];
+        unsigned char currentH = TexelHeight(current);
+        unsigned char entityH = (unsigned char)(baseH + (currentH & followMask) + heights[k]);
+        // Only paint if the entity is "above" the existing terrain
+        bool draw = heights[k] != 0 && entityH >= currentH;
+        dst[k] = draw ? PackTexel(entityH, colors[k]) : dst[k];
+        top = (draw && entityH > top) ? entityH : top;
+    }
+    return top;
+}
+
+void PaintEntities(EntityManager *manager, Terrain *terrain, const EngineState *view) {
+    // Last frame's saves were consumed by RestoreEntities
+    manager->saveArenaUsed = 0;
+    manager->paintedCount = 0;
+
+    TerrainOverlay *overlay = NULL;
+    if (!gameSettings.paintIntoTerrain) {
+        overlay = &manager->overlay;
+        if (overlay->size != terrain->size) {
+            UnloadTerrainOverlay(overlay);
+            InitTerrainOverlay(overlay, terrain->size);
+        }
+    }
+
+    ViewWedge wedge;
+    if (view) wedge = MakeViewWedge(view);
+
+    float mapSize = (float)gameSettings.mapSize;
+    float alpha = manager->simAlpha;
+
+    for(int i=0; i<manager->count; i++) {
+        EntityType type = (EntityType)manager->type[i];
+
+        // Drawn between the last two simulation steps
+        float x = manager->prevX[i] + WrappedDelta(manager->prevX[i], manager->x[i], mapSize) * alpha;
+        float y = manager->prevY[i] + WrappedDelta(manager->prevY[i], manager->y[i], mapSize) * alpha;
+
+        // Culled entities get an empty rect, Restore skips them
+        float radius = (manager->width[i] + manager->length[i]) * 0.5f + 1.0f;
+        if (view && !InViewWedge(&wedge, x, y, radius)) {
+            manager->paint[i] = (EntityRect){0};
+            continue;
+        }
+        manager->paintedCount++;
+
+        const VoxelModel *model = manager->model[i] ? manager->model[i] : &fallbackModels[type];
+        const ModelVariant *v = &model->variants[manager->facing[i]];
+
+        int px = (int)floorf(x) + v->x;
+        int py = (int)floorf(y) + v->y;
+
+        // Store bounds for Restore pass, only the terrain needs saving
+        manager->paint[i] = (EntityRect){ px, py, v->width, v->length };
+        TerrainTexel *saved = overlay ? NULL : AllocSaveTexels(manager, i, (size_t)v->width * v->length);
+
+        unsigned char baseH = manager->z_offset[i];
+        unsigned char followMask = (type == ENTITY_SHIP) ? 0x00 : 0xFF;
+
+        for (int dy = 0; dy < v->length; dy++) {
+            // Handle map wrapping
+            int mapY = (py + dy) & terrain->mask;
+            const unsigned char *heights = v->heights + dy * v->width;
+            const unsigned char *colors = v->colorIndex + dy * v->width;
+
+            // Split the row where it leaves an overlay tile (or wraps)
+            for (int dx = 0; dx < v->width; ) {
+                int mapX = (px + dx) & terrain->mask;
+                int run = OVERLAY_TILE - (mapX & OVERLAY_TILE_MASK);
+                if (run > v->width - dx) run = v->width - dx;
+
+                TerrainTexel *under = &terrain->texels[TerrainIndex(terrain, mapX, mapY)];
+                TerrainTexel *dst = under;
+                if (overlay) {
+                    dst = OverlayTexelForWrite(overlay, mapX, mapY);
+                } else {
+                    memcpy(saved + dy * v->width + dx, under, run * sizeof(TerrainTexel));
                 }
 
-                bufIndex++;
+                int top = BlitModelRun(dst, under, heights + dx, colors + dx, run, baseH, followMask);
+                if (overlay && top > overlay->maxHeight) overlay->maxHeight = top;
+                if (!overlay && top > terrain->maxHeight) terrain->maxHeight = top;
+                dx += run;
             }
         }
     }
 }
 
 void RestoreEntities(EntityManager *manager, Terrain *terrain) {
+    if (!gameSettings.paintIntoTerrain) {
+        ClearTerrainOverlay(&manager->overlay);
+        return;
+    }
+
     // LIFO Restore to handle overlaps correctly
-    for(int i = MAX_ENTITIES - 1; i >= 0; i--) {
-        Entity *e = &manager->list[i];
-        if (!e->active) continue;
+    for(int i = manager->count - 1; i >= 0; i--) {
+        EntityRect r = manager->paint[i];
+        const TerrainTexel *saved = manager->saveArena + manager->saveOffset[i];
 
         int bufIndex = 0;
-        for(int dy = 0; dy < e->paint_h; dy++) {
-            for(int dx = 0; dx < e->paint_w; dx++) {
-                int mx = (e->paint_x + dx) & (gameSettings.mapSize - 1);
-                int my = (e->paint_y + dy) & (gameSettings.mapSize - 1);
-                int mapIndex = my * gameSettings.mapSize + mx;
-                
-                if (bufIndex >= MAX_ENTITY_SIZE * MAX_ENTITY_SIZE) break;
-
-                terrain->heightmapRaw[mapIndex] = e->savedHeights[bufIndex];
-                terrain->colormapData[mapIndex] = e->savedColors[bufIndex];
-                
+        for(int dy = 0; dy < r.h; dy++) {
+            for(int dx = 0; dx < r.w; dx++) {
+                int mapIndex = TerrainIndexWrapped(terrain, r.x + dx, r.y + dy);
+                terrain->texels[mapIndex] = saved[bufIndex];
                 bufIndex++;
             }
         }
     }
-}
\ No newline at end of file
+}
+
+const TerrainOverlay *GetEntityOverlay(const EntityManager *manager) {
+    if (gameSettings.paintIntoTerrain || manager->overlay.usedCount == 0) return NULL;
+    return &manager->overlay;
+}
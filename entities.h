@@ -3,6 +3,10 @@
 
 #include "raylib.h"
 #include "terrain.h"
+#include "engine.h"
+#include "overlay.h"
+#include "spatial.h"
+#include <stdint.h>
 
 typedef enum {
     ENTITY_SHIP,
@@ -10,6 +14,15 @@ typedef enum {
     ENTITY_BUILDING
 } EntityType;
 
+// A model turned to one facing and cropped to its visible voxels. Rows are
+// packed (width texels each), so painting is a plain rectangular blit.
+typedef struct {
+    int x, y;              // Top-left corner relative to the entity position
+    int width, length;     // Cropped size along map x and y, 0 if empty
+    unsigned char heights[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
+    unsigned char colorIndex[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
+} ModelVariant;
+
 typedef struct {
     char name[64];
     EntityType type;
@@ -17,6 +30,8 @@ typedef struct {
     int length;
     unsigned char heights[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
     Color colors[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
+    unsigned char colorIndex[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE]; // colors mapped to the terrain palette
+    ModelVariant variants[4];  // Pre-rotated per facing, built on load
 } VoxelModel;
 
 #define MAX_LOADED_MODELS 128
@@ -29,48 +44,133 @@ typedef struct {
 extern ModelRegistry modelRegistry;
 
 typedef struct {
-    bool active;
-    EntityType type;
-    const VoxelModel *model;
+    int x, y, w, h;
+} EntityRect;
 
-    // Position and Movement
-    float x, y, z;     // Map coordinates. z is usually base height + offset
-    float dx, dy;      // Velocity
-    float angle;       // Rotation in radians
-    int facing;        // 0: Right, 1: Down, 2: Left, 3: Up
-    float speed;
+// Stable reference to an entity. Dense indices change when other entities
+// are removed, handles do not; a handle to a removed entity is detected by
+// its generation no longer matching the slot's.
+typedef struct {
+    uint32_t slot;
+    uint32_t generation;  // 0 never names a live entity
+} EntityHandle;
 
-    // Dimensions
-    int width;
-    int length;
-    int height_shape;  // How tall the voxel shape is
-    int z_offset;
+#define ENTITY_NULL ((EntityHandle){0, 0})
 
-    // Visuals
-    Color color;
-    unsigned char savedHeights[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
-    Color savedColors[MAX_ENTITY_SIZE * MAX_ENTITY_SIZE];
-    int paint_x, paint_y, paint_w, paint_h;
-} Entity;
+// Footprint snapshot used by collision, packed by grid cell
+typedef struct {
+    float x, y;
+    float halfX, halfY;
+    float share;          // Part of the separation the other entity takes
+    int index;
+} EntityCollider;
 
+// Entities live in parallel arrays packed in [0, count): every loop walks
+// only live entities and only touches the fields it needs. Index i is the
+// same entity in every array. Removal moves the last entity into the hole.
 typedef struct {
-    Entity list[MAX_ENTITIES];
     int count;
+    int capacity;
+    uint32_t spawnSerial;  // Entities ever added, keys their random streams
+
+    // Fixed timestep: time not yet simulated, and how far rendering is
+    // between the previous and the current step (0..1)
+    float simAccumulator;
+    float simAlpha;
+
+    // Movement (read and written every simulation step)
+    float *x;                      // Map coordinates
+    float *y;
+    float *prevX;                  // Position before the last step, for interpolation
+    float *prevY;
+    float *dx;                     // Velocity
+    float *dy;
+    unsigned char *facing;         // 0: Right, 1: Down, 2: Left, 3: Up
+    unsigned char *type;           // EntityType
+
+    // Per-entity random stream (see random.h)
+    uint32_t *rngKey;
+    uint32_t *rngCounter;
+
+    // Shape (read when painting)
+    const VoxelModel **model;      // NULL: the type's procedural fallback
+    unsigned short *width;
+    unsigned short *length;
+    unsigned char *z_offset;
+    float *speed;
+
+    // Entity texels the renderer draws over the terrain
+    TerrainOverlay overlay;
+
+    // Paint & Restore (gameSettings.paintIntoTerrain): painted rectangle and
+    // the terrain saved under it. Saves are bump-allocated from one arena,
+    // reset by every PaintEntities.
+    EntityRect *paint;
+    size_t *saveOffset;            // First saved texel in saveArena
+    TerrainTexel *saveArena;
+    size_t saveArenaCapacity;      // In texels, grows as needed
+    size_t saveArenaUsed;
+    int paintedCount;              // Entities the last PaintEntities did not cull
+
+    // Spatial index by slot, kept current by Add/Remove/UpdateEntities
+    EntityGrid grid;
+
+    // Collision scratch for UpdateEntities: footprints sorted by cell
+    // (cell c owns colliders[colliderStart[c] .. colliderStart[c + 1]))
+    // and the separation found for each entity
+    EntityCollider *colliders;
+    int *colliderStart;
+    float colliderMaxHalf;         // Largest half extent in the snapshot
+    float *pushX;
+    float *pushY;
+
+    // Handles: slot -> dense index (or next free slot), dense index -> slot
+    int *slotIndex;
+    uint32_t *slotGeneration;
+    uint32_t *denseSlot;
+    int freeSlot;                  // Head of the free slot list, -1 if full
 } EntityManager;
 
-void InitEntityManager(EntityManager *manager);
-void AddEntity(EntityManager *manager, EntityType type, float x, float y);
-void AddEntityFromModel(EntityManager *manager, EntityType type, float x, float y, const VoxelModel *model);
+// capacity <= 0 uses MAX_ENTITIES
+void InitEntityManager(EntityManager *manager, int capacity);
+void UnloadEntityManager(EntityManager *manager);
+EntityHandle AddEntity(EntityManager *manager, EntityType type, float x, float y);
+// Returns ENTITY_NULL if the manager is full
+EntityHandle AddEntityFromModel(EntityManager *manager, EntityType type, float x, float y, const VoxelModel *model);
+// O(1). Must not be called between PaintEntities and RestoreEntities.
+// Returns false for stale or null handles.
+bool RemoveEntity(EntityManager *manager, EntityHandle handle);
+// Dense index of a live entity, -1 for stale or null handles
+int GetEntityIndex(const EntityManager *manager, EntityHandle handle);
+EntityHandle GetEntityHandle(const EntityManager *manager, int index);
+// Spatial queries on entity positions. The map wraps, so queries near an
+// edge also see entities just across it. Up to maxResults handles are
+// written to results (NULL with maxResults 0 just counts); the return
+// value is the number of matches, which may be larger.
+int QueryEntitiesInRect(const EntityManager *manager, EntityRect rect, EntityHandle *results, int maxResults);
+int QueryEntitiesInRadius(const EntityManager *manager, float x, float y, float radius, EntityHandle *results, int maxResults);
+// Closest entity within maxDistance of (x, y), ENTITY_NULL if none
+EntityHandle FindNearestEntity(const EntityManager *manager, float x, float y, float maxDistance);
+// Places count entities at random spots with suitable terrain (water for ships)
+void SpawnEntitySmart(EntityManager *manager, const Terrain *terrain, EntityType type, int count);
+// Advances the simulation by deltaTime in fixed SIM_STEP steps, each one
+// split over the job system. Painting interpolates the leftover time.
 void UpdateEntities(EntityManager *manager, float deltaTime, const Terrain *terrain);
 
-// The "Paint & Restore" Rendering methods
-void PaintEntities(EntityManager *manager, Terrain *terrain);
+// Entities are painted into the overlay and cleared by RestoreEntities;
+// the terrain is only read. With gameSettings.paintIntoTerrain they are
+// written into the terrain itself and RestoreEntities puts it back.
+// Only entities inside the renderer's view wedge for view are painted,
+// view NULL paints all of them.
+void PaintEntities(EntityManager *manager, Terrain *terrain, const EngineState *view);
 void RestoreEntities(EntityManager *manager, Terrain *terrain);
+// Overlay to pass to DrawVertexSpace, NULL when there is nothing in it
+const TerrainOverlay *GetEntityOverlay(const EntityManager *manager);
 
 // Model Management
 void InitModelRegistry();
 void LoadAllModels();
 void SaveModel(const VoxelModel *model);
-VoxelModel* GetRandomModel(EntityType type);
+VoxelModel* GetRandomModel(EntityType type, uint32_t random);
 
 #endif // ENTITIES_H
@@ -7,32 +7,16 @@
 #include "entities.h"
 #include "settings.h"
 #include "editor.h"
+#include "world.h"
 #include <stdlib.h>
-
-GameSettings gameSettings;
-
-void SpawnEntitySmart(EntityManager *manager, const Terrain *terrain, EntityType type, int count) {
-  int spawned = 0;
-  int attempts = 0;
-  while(spawned < count && attempts < count * 1000) {
-    attempts++;
-    int x = GetRandomValue(0, gameSettings.mapSize - 1);
-    int y = GetRandomValue(0, gameSettings.mapSize - 1);
-    int index = y * gameSettings.mapSize + x;
-    unsigned char h = terrain->heightmapRaw[index];
-
-    bool valid = false;
-    if (type == ENTITY_SHIP) {
-      if (h <= LEVEL_WATER) valid = true;
-    } else if (type == ENTITY_UNIT || type == ENTITY_BUILDING) {
-      if (h > LEVEL_WATER + 2 && h < LEVEL_SAND) valid = true;
-    }
-
-    if (valid) {
-      AddEntity(manager, type, (float)x, (float)y);
-      spawned++;
-    }
-  }
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Overall progress across all terrain stages, redrawn between job chunks
+static void ReportTerrainProgress(TerrainStage stage, float progress) {
+  float overall = ((float)stage + progress) / TERRAIN_STAGE_COUNT;
+  DrawLoadingProgress(TextFormat("Generating Terrain (%s)...", terrainStageNames[stage]), overall);
 }
 
 void RunSetup() {
@@ -96,34 +80,10 @@ void RunSetup() {
   gameSettings.gameMode = MODE_GAME;
 
   switch(selection) {
-    case 0: // 1024
-      gameSettings.mapSize = 1024;
-      gameSettings.noiseScale = 2.0f;
-      gameSettings.shipCount = 10;
-      gameSettings.unitCount = 40;
-      gameSettings.buildingCount = 20;
-      break;
-    case 1: // 2048
-      gameSettings.mapSize = 2048;
-      gameSettings.noiseScale = 4.0f;
-      gameSettings.shipCount = 20;
-      gameSettings.unitCount = 120;
-      gameSettings.buildingCount = 40;
-      break;
-    case 2: // 4096
-      gameSettings.mapSize = 4096;
-      gameSettings.noiseScale = 8.0f;
-      gameSettings.shipCount = 100;
-      gameSettings.unitCount = 250;
-      gameSettings.buildingCount = 80;
-      break;
-    case 3: // 8192
-      gameSettings.mapSize = 8192;
-      gameSettings.noiseScale = 16.0f;
-      gameSettings.shipCount = 500;
-      gameSettings.unitCount = 1000;
-      gameSettings.buildingCount = 100;
-      break;
+    case 0: ApplyMapPreset(1024); break;
+    case 1: ApplyMapPreset(2048); break;
+    case 2: ApplyMapPreset(4096); break;
+    case 3: ApplyMapPreset(8192); break;
     case 4: // Editor
       gameSettings.gameMode = MODE_EDITOR;
       gameSettings.mapSize = 1024;
@@ -136,8 +96,86 @@ void RunSetup() {
   CloseWindow();
 }
 
-int main(void)
+// Command line:
+//   --res WxH | --res native   Internal render resolution
+//   --dynamic-res              Scale the resolution to hold the render budget
+//   --target-ms N              Render budget for --dynamic-res (ms)
+//   --threads N                Worker threads (0 = one per core)
+//   --seed N                   World seed (default: current time), enables the world cache
+//   --max-entities N           Entity capacity (default MAX_ENTITIES)
+//   --no-cache                 Always generate, never read or write the world cache
+//   --paint-restore            Write entities into the terrain instead of the overlay
+//   --draw-distance N          Farthest terrain plane in map texels
+//   --plane-growth G           Plane spacing as a fraction of the distance (0 = 1 texel)
+//   --ray-march                Render column by column, skipping empty space
+//   --fog                      Distance fog (implies --ray-march)
+void ParseCommandLine(int argc, char **argv) {
+  gameSettings.seed = (unsigned int)time(NULL);
+  bool cacheDisabled = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char *value = (i + 1 < argc) ? argv[i + 1] : "";
+
+    if (strcmp(argv[i], "--res") == 0) {
+      if (strcmp(value, "native") == 0) {
+        gameSettings.renderWidth = -1;
+        gameSettings.renderHeight = -1;
+      } else if (sscanf(value, "%dx%d", &gameSettings.renderWidth, &gameSettings.renderHeight) != 2) {
+        TraceLog(LOG_WARNING, "Invalid --res value: %s", value);
+        gameSettings.renderWidth = 0;
+        gameSettings.renderHeight = 0;
+      }
+      i++;
+    }
+    else if (strcmp(argv[i], "--dynamic-res") == 0) {
+      gameSettings.dynamicResolution = true;
+    }
+    else if (strcmp(argv[i], "--target-ms") == 0) {
+      gameSettings.targetRenderMs = (float)atof(value);
+      i++;
+    }
+    else if (strcmp(argv[i], "--threads") == 0) {
+      gameSettings.threadCount = atoi(value);
+      i++;
+    }
+    else if (strcmp(argv[i], "--seed") == 0) {
+      gameSettings.seed = (unsigned int)strtoul(value, NULL, 10);
+      gameSettings.worldCache = true;
+      i++;
+    }
+    else if (strcmp(argv[i], "--max-entities") == 0) {
+      gameSettings.entityCapacity = atoi(value);
+      i++;
+    }
+    else if (strcmp(argv[i], "--no-cache") == 0) {
+      cacheDisabled = true;
+    }
+    else if (strcmp(argv[i], "--paint-restore") == 0) {
+      gameSettings.paintIntoTerrain = true;
+    }
+    else if (strcmp(argv[i], "--draw-distance") == 0) {
+      gameSettings.drawDistance = (float)atof(value);
+      i++;
+    }
+    else if (strcmp(argv[i], "--plane-growth") == 0) {
+      float growth = (float)atof(value);
+      gameSettings.planeGrowth = (growth > 0.0f) ? growth : -1.0f;
+      i++;
+    }
+    else if (strcmp(argv[i], "--ray-march") == 0) {
+      gameSettings.rayMarch = true;
+    }
+    else if (strcmp(argv[i], "--fog") == 0) {
+      gameSettings.fog = true;
+    }
+  }
+
+  if (cacheDisabled) gameSettings.worldCache = false;
+}
+
+int main(int argc, char **argv)
 {
+    ParseCommandLine(argc, argv);
     RunSetup();
 
     if (gameSettings.gameMode == MODE_QUIT) return 0;
@@ -155,14 +193,21 @@ int main(void)
     InitEngine(&engineState);
     InitRenderer(&renderer);
 
-    DrawLoadingMessage("Generating Terrain (Please Wait)...");
-    GenerateProceduralTerrain(&terrain);
+    TraceLog(LOG_INFO, "WORLD: seed %u", gameSettings.seed);
+    InitEntityManager(entityManager, gameSettings.entityCapacity);
 
-    InitEntityManager(entityManager);
+    // Only a seed given on the command line can hit the cache again, random
+    // seeds would just fill the disk.
+    const char *worldPath = GetWorldCachePath();
+    if (!gameSettings.worldCache || !LoadWorld(worldPath, &terrain, entityManager)) {
+        GenerateProceduralTerrain(&terrain, ReportTerrainProgress);
 
-    SpawnEntitySmart(entityManager, &terrain, ENTITY_SHIP, gameSettings.shipCount);
-    SpawnEntitySmart(entityManager, &terrain, ENTITY_UNIT, gameSettings.unitCount);
-    SpawnEntitySmart(entityManager, &terrain, ENTITY_BUILDING, gameSettings.buildingCount);
+        SpawnEntitySmart(entityManager, &terrain, ENTITY_SHIP, gameSettings.shipCount);
+        SpawnEntitySmart(entityManager, &terrain, ENTITY_UNIT, gameSettings.unitCount);
+        SpawnEntitySmart(entityManager, &terrain, ENTITY_BUILDING, gameSettings.buildingCount);
+
+        if (gameSettings.worldCache) SaveWorld(worldPath, &terrain, entityManager);
+    }
 
 
     // Spawn Menu State
@@ -221,13 +266,17 @@ int main(void)
                     if (CheckCollisionPointRec(mouse, itemRect)) {
                         
                         // Validate
-                        int index = spawnMapY * gameSettings.mapSize + spawnMapX;
-                        unsigned char h = terrain.heightmapRaw[index];
+                        int index = TerrainIndex(&terrain, spawnMapX, spawnMapY);
+                        unsigned char h = TexelHeight(terrain.texels[index]);
                         bool valid = false;
 
                         if (m->type == ENTITY_SHIP && h <= LEVEL_WATER) valid = true;
                         if ((m->type == ENTITY_UNIT || m->type == ENTITY_BUILDING) && h > LEVEL_WATER) valid = true;
 
+                        // Keep clear of entities already standing there
+                        float clearance = (m->width + m->length) * 0.25f;
+                        if (QueryEntitiesInRadius(entityManager, (float)spawnMapX, (float)spawnMapY, clearance, NULL, 0) > 0) valid = false;
+
                         if (valid) {
                             AddEntityFromModel(entityManager, m->type, (float)spawnMapX, (float)spawnMapY, m);
                         }
@@ -244,9 +293,9 @@ int main(void)
         HandleInput(&engineState, &terrain);
         UpdateEntities(entityManager, engineState.deltaTime, &terrain);
 
-        PaintEntities(entityManager, &terrain);
+        PaintEntities(entityManager, &terrain, &engineState);
         ClearFrameBuffer(&renderer, renderer.sky_color);
-        DrawVertexSpace(&renderer, &engineState, &terrain);
+        DrawVertexSpace(&renderer, &engineState, &terrain, GetEntityOverlay(entityManager));
         RestoreEntities(entityManager, &terrain);
 
         UpdateRendererTexture(&renderer);
@@ -312,6 +361,7 @@ int main(void)
         EndDrawing();
     }
 
+    UnloadEntityManager(entityManager);
     free(entityManager);
     UnloadTerrain(&terrain);
     CloseRenderer(&renderer);
@@ -0,0 +1,154 @@
+#define _POSIX_C_SOURCE 200809L
+#include "jobs.h"
+#include "constants.h"
+#include <stdbool.h>
+
+// The web build has no pthreads; every job runs inline on the main thread.
+#if !defined(PLATFORM_WEB)
+#define JOBS_THREADED
+#include <pthread.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#endif
+
+#ifdef JOBS_THREADED
+
+static pthread_t workers[MAX_WORKER_THREADS];
+static int workerCount = 0; // Threads besides the main thread
+
+static pthread_mutex_t jobMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDone = PTHREAD_COND_INITIALIZER;
+
+// Current dispatch (guarded by jobMutex)
+static JobFunc jobFunc;
+static void *jobData;
+static int jobCount;
+static int jobBatch;
+static int nextItem;
+static int batchesPending;
+static bool quitWorkers;
+
+static int GetCpuCount(void) {
+#ifdef _WIN32
+  int n = pthread_num_processors_np();
+#else
+  int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return (n > 0) ? n : 1;
+}
+
+// Takes the next batch of the current dispatch. Called with jobMutex held.
+static bool GrabBatch(int *start, int *end) {
+  if (nextItem >= jobCount) return false;
+  *start = nextItem;
+  *end = nextItem + jobBatch;
+  if (*end > jobCount) *end = jobCount;
+  nextItem = *end;
+  return true;
+}
+
+static void *WorkerMain(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&jobMutex);
+  for (;;) {
+    while (!quitWorkers && nextItem >= jobCount) {
+      pthread_cond_wait(&jobStart, &jobMutex);
+    }
+    if (quitWorkers) break;
+
+    int start, end;
+    while (GrabBatch(&start, &end)) {
+      JobFunc func = jobFunc;
+      void *data = jobData;
+      pthread_mutex_unlock(&jobMutex);
+      func(data, start, end);
+      pthread_mutex_lock(&jobMutex);
+      if (--batchesPending == 0) pthread_cond_signal(&jobDone);
+    }
+  }
+  pthread_mutex_unlock(&jobMutex);
+  return NULL;
+}
+
+void InitJobSystem(int threadCount) {
+  if (threadCount <= 0) threadCount = GetCpuCount();
+  if (threadCount > MAX_WORKER_THREADS) threadCount = MAX_WORKER_THREADS;
+
+  quitWorkers = false;
+  nextItem = jobCount = 0;
+  workerCount = 0;
+  for (int i = 0; i < threadCount - 1; i++) {
+    if (pthread_create(&workers[workerCount], NULL, WorkerMain, NULL) != 0) break;
+    workerCount++;
+  }
+}
+
+int GetJobThreadCount(void) {
+  return workerCount + 1;
+}
+
+void RunParallel(JobFunc func, void *data, int count, int batchSize) {
+  if (count <= 0) return;
+  if (batchSize < 1) batchSize = 1;
+
+  if (workerCount == 0 || count <= batchSize) {
+    func(data, 0, count);
+    return;
+  }
+
+  pthread_mutex_lock(&jobMutex);
+  jobFunc = func;
+  jobData = data;
+  jobCount = count;
+  jobBatch = batchSize;
+  nextItem = 0;
+  batchesPending = (count + batchSize - 1) / batchSize;
+  pthread_cond_broadcast(&jobStart);
+
+  // The main thread works on the same queue instead of idling
+  int start, end;
+  while (GrabBatch(&start, &end)) {
+    pthread_mutex_unlock(&jobMutex);
+    func(data, start, end);
+    pthread_mutex_lock(&jobMutex);
+    batchesPending--;
+  }
+  while (batchesPending > 0) {
+    pthread_cond_wait(&jobDone, &jobMutex);
+  }
+  pthread_mutex_unlock(&jobMutex);
+}
+
+void CloseJobSystem(void) {
+  pthread_mutex_lock(&jobMutex);
+  quitWorkers = true;
+  pthread_cond_broadcast(&jobStart);
+  pthread_mutex_unlock(&jobMutex);
+
+  for (int i = 0; i < workerCount; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  workerCount = 0;
+}
+
+#else
+
+void InitJobSystem(int threadCount) {
+  (void)threadCount;
+}
+
+int GetJobThreadCount(void) {
+  return 1;
+}
+
+void RunParallel(JobFunc func, void *data, int count, int batchSize) {
+  (void)batchSize;
+  if (count > 0) func(data, 0, count);
+}
+
+void CloseJobSystem(void) {
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+// Processes items [start, end) of a parallel loop.
+typedef void (*JobFunc)(void *data, int start, int end);
+
+// threadCount <= 0 picks one thread per CPU core (including the main thread).
+void InitJobSystem(int threadCount);
+int GetJobThreadCount(void);
+
+// Splits [0, count) into batches of batchSize items and runs them on the
+// worker pool and the calling thread. Blocks until every batch is done.
+// Must be called from the main thread only (not from inside a job).
+void RunParallel(JobFunc func, void *data, int count, int batchSize);
+
+void CloseJobSystem(void);
+
+#endif // JOBS_H
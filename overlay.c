@@ -0,0 +1,63 @@
+#include "overlay.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define OVERLAY_INITIAL_SLOTS 64
+
+void InitTerrainOverlay(TerrainOverlay *overlay, int size)
+{
+    overlay->size = size;
+    overlay->tileRowShift = 0;
+    while ((OVERLAY_TILE << overlay->tileRowShift) < size) overlay->tileRowShift++;
+
+    int tileCount = 1 << (2 * overlay->tileRowShift);
+    overlay->tileSlot = (int *)malloc(tileCount * sizeof(int));
+    for (int i = 0; i < tileCount; i++) overlay->tileSlot[i] = -1;
+
+    overlay->capacity = OVERLAY_INITIAL_SLOTS;
+    overlay->tiles = (TerrainTexel *)malloc((size_t)overlay->capacity * OVERLAY_TILE_TEXELS * sizeof(TerrainTexel));
+    overlay->slotTile = (int *)malloc(overlay->capacity * sizeof(int));
+    overlay->usedCount = 0;
+    overlay->maxHeight = 0;
+}
+
+void UnloadTerrainOverlay(TerrainOverlay *overlay)
+{
+    free(overlay->tileSlot);
+    free(overlay->tiles);
+    free(overlay->slotTile);
+    overlay->tileSlot = NULL;
+    overlay->tiles = NULL;
+    overlay->slotTile = NULL;
+    overlay->usedCount = 0;
+    overlay->capacity = 0;
+}
+
+void ClearTerrainOverlay(TerrainOverlay *overlay)
+{
+    for (int s = 0; s < overlay->usedCount; s++) {
+        overlay->tileSlot[overlay->slotTile[s]] = -1;
+    }
+    overlay->usedCount = 0;
+    overlay->maxHeight = 0;
+}
+
+TerrainTexel *OverlayTexelForWrite(TerrainOverlay *overlay, int x, int y)
+{
+    int tile = ((y >> OVERLAY_TILE_SHIFT) << overlay->tileRowShift) + (x >> OVERLAY_TILE_SHIFT);
+    int slot = overlay->tileSlot[tile];
+
+    if (slot < 0) {
+        if (overlay->usedCount == overlay->capacity) {
+            overlay->capacity *= 2;
+            overlay->tiles = (TerrainTexel *)realloc(overlay->tiles, (size_t)overlay->capacity * OVERLAY_TILE_TEXELS * sizeof(TerrainTexel));
+            overlay->slotTile = (int *)realloc(overlay->slotTile, overlay->capacity * sizeof(int));
+        }
+        slot = overlay->usedCount++;
+        overlay->slotTile[slot] = tile;
+        overlay->tileSlot[tile] = slot;
+        memset(overlay->tiles + (size_t)slot * OVERLAY_TILE_TEXELS, 0, OVERLAY_TILE_TEXELS * sizeof(TerrainTexel));
+    }
+
+    return &overlay->tiles[slot * OVERLAY_TILE_TEXELS + ((y & OVERLAY_TILE_MASK) << OVERLAY_TILE_SHIFT) + (x & OVERLAY_TILE_MASK)];
+}
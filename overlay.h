@@ -0,0 +1,64 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include "terrain.h"
+
+// Sparse layer of texels drawn over the terrain (painted entities).
+// Only OVERLAY_TILE x OVERLAY_TILE tiles that hold something are backed by
+// memory; texel 0 means "show the terrain". The terrain itself is never
+// written, so render threads can share it read-only.
+#define OVERLAY_TILE_SHIFT 5
+#define OVERLAY_TILE (1 << OVERLAY_TILE_SHIFT)
+#define OVERLAY_TILE_MASK (OVERLAY_TILE - 1)
+#define OVERLAY_TILE_TEXELS (OVERLAY_TILE * OVERLAY_TILE)
+
+typedef struct {
+    int size;                 // Map edge length in texels
+    int tileRowShift;         // log2(tiles per row)
+    int *tileSlot;            // Map tile -> slot in tiles, -1 if empty
+    TerrainTexel *tiles;      // OVERLAY_TILE_TEXELS per slot
+    int *slotTile;            // Map tile of every used slot, for clearing
+    int usedCount;
+    int capacity;             // Slots allocated, grows as needed
+    int maxHeight;            // Upper bound of the texel heights, kept by the writer
+} TerrainOverlay;
+
+void InitTerrainOverlay(TerrainOverlay *overlay, int size);
+void UnloadTerrainOverlay(TerrainOverlay *overlay);
+// Empties the overlay, cost proportional to the tiles in use
+void ClearTerrainOverlay(TerrainOverlay *overlay);
+
+// Writable texel (x, y), allocating its tile. x and y must be in [0, size).
+// The caller raises maxHeight to cover what it writes.
+TerrainTexel *OverlayTexelForWrite(TerrainOverlay *overlay, int x, int y);
+
+// Overlay texel at (x, y), 0 if none. x and y must be in [0, size).
+static inline TerrainTexel OverlayTexel(const TerrainOverlay *overlay, int x, int y) {
+    int tile = ((y >> OVERLAY_TILE_SHIFT) << overlay->tileRowShift) + (x >> OVERLAY_TILE_SHIFT);
+    int slot = overlay->tileSlot[tile];
+    if (slot < 0) return 0;
+    return overlay->tiles[slot * OVERLAY_TILE_TEXELS + ((y & OVERLAY_TILE_MASK) << OVERLAY_TILE_SHIFT) + (x & OVERLAY_TILE_MASK)];
+}
+
+// What the renderer sees at (x, y): the overlay where set, else the terrain.
+// overlay may be NULL.
+static inline TerrainTexel SampleTerrain(const Terrain *terrain, const TerrainOverlay *overlay, int x, int y) {
+    if (overlay) {
+        TerrainTexel texel = OverlayTexel(overlay, x, y);
+        if (texel) return texel;
+    }
+    return terrain->texels[TerrainIndex(terrain, x, y)];
+}
+
+// SampleTerrain at a terrain mip level (0: full resolution). The overlay
+// has no mips, entities are still looked up at (x, y).
+static inline TerrainTexel SampleTerrainLevel(const Terrain *terrain, const TerrainOverlay *overlay, int level, int x, int y) {
+    if (level == 0) return SampleTerrain(terrain, overlay, x, y);
+    if (overlay) {
+        TerrainTexel texel = OverlayTexel(overlay, x, y);
+        if (texel) return texel;
+    }
+    return TerrainMipTexel(terrain, level, x, y);
+}
+
+#endif // OVERLAY_H
@@ -0,0 +1,104 @@
+#include "palette.h"
+#include <stdbool.h>
+
+const Color dbPalette[PALETTE_SIZE] = {
+    DB_BLACK, DB_VALHALLA, DB_LOULOU, DB_OILED_CEDAR, DB_ROPE, DB_TAHITI_GOLD, DB_TWINE, DB_PANCHO,
+    DB_GOLDEN_FIZZ, DB_ATLANTIS, DB_CHRISTI, DB_ELF_GREEN, DB_DELL, DB_VERDUN_GREEN, DB_OPAL, DB_DEEP_KOAMARU,
+    DB_VENICE_BLUE, DB_ROYAL_BLUE, DB_KURT, DB_WIND_BLUE, DB_LINK_WATER, DB_WHITE, DB_SILVER, DB_IRON,
+    DB_SHUTTLE_GREY, DB_CASCADE, DB_MING, DB_MOZART, DB_OLD_ROSE, DB_MAUVELOUS, DB_APPLE_BLOSSOM, DB_SAPLING
+};
+
+Color paletteColors[PALETTE_SIZE * PALETTE_SHADES];
+
+// Representative lighting value of each shade step
+static const int shadeLight[PALETTE_SHADES] = { -19, -12, -6, -2, 0, 6, 15, 30 };
+
+// Gradient lighting from the terrain generator, applied once per ramp entry
+static Color ApplyLight(Color col, int lightVal)
+{
+    if (lightVal < 0) {
+        // Shadow: darker and more saturated
+        float factor = 1.0f + (lightVal * 0.04f);
+        if (factor < 0.25f) factor = 0.25f;
+
+        float r = (float)col.r * factor;
+        float g = (float)col.g * factor;
+        float b = (float)col.b * factor;
+
+        // Saturation boost
+        float gray = (r + g + b) / 3.0f;
+        float satAmount = 1.4f;
+
+        r = gray + (r - gray) * satAmount;
+        g = gray + (g - gray) * satAmount;
+        b = gray + (b - gray) * satAmount;
+
+        if (r < 0) r = 0;
+        if (r > 255) r = 255;
+        if (g < 0) g = 0;
+        if (g > 255) g = 255;
+        if (b < 0) b = 0;
+        if (b > 255) b = 255;
+
+        col.r = (unsigned char)r;
+        col.g = (unsigned char)g;
+        col.b = (unsigned char)b;
+    } else {
+        // Light: additive brightness
+        int r = col.r + lightVal;
+        int g = col.g + lightVal;
+        int b = col.b + lightVal;
+
+        if (r > 255) r = 255;
+        if (g > 255) g = 255;
+        if (b > 255) b = 255;
+
+        col.r = (unsigned char)r;
+        col.g = (unsigned char)g;
+        col.b = (unsigned char)b;
+    }
+    return col;
+}
+
+void InitPalette(void)
+{
+    static bool initialized = false;
+    if (initialized) return;
+
+    for (int c = 0; c < PALETTE_SIZE; c++) {
+        for (int s = 0; s < PALETTE_SHADES; s++) {
+            paletteColors[c * PALETTE_SHADES + s] = ApplyLight(dbPalette[c], shadeLight[s]);
+        }
+    }
+    initialized = true;
+}
+
+unsigned char PaletteIndex(Color color)
+{
+    int best = 0;
+    int bestDist = 0x7FFFFFFF;
+    for (int i = 0; i < PALETTE_SIZE * PALETTE_SHADES; i++) {
+        int dr = color.r - paletteColors[i].r;
+        int dg = color.g - paletteColors[i].g;
+        int db = color.b - paletteColors[i].b;
+        int dist = dr * dr + dg * dg + db * db;
+        // Prefer the unlit shade on ties so pure palette colors map to base
+        if (dist < bestDist || (dist == bestDist && i % PALETTE_SHADES == SHADE_BASE)) {
+            best = i;
+            bestDist = dist;
+        }
+    }
+    return (unsigned char)best;
+}
+
+int ShadeForLight(int lightVal)
+{
+    if (lightVal <= -16) return 0;
+    if (lightVal <= -9) return 1;
+    if (lightVal <= -4) return 2;
+    if (lightVal < 0) return 3;
+    if (lightVal == 0) return SHADE_BASE;
+    if (lightVal <= 10) return 5;
+    if (lightVal <= 22) return 6;
+    return 7;
+}
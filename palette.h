@@ -0,0 +1,37 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include "raylib.h"
+#include "constants.h"
+
+// Indexed color: every terrain and frame buffer color is one byte,
+// color * PALETTE_SHADES + shade, expanded through paletteColors[] only
+// when the frame is handed to the GPU.
+#define PALETTE_SIZE 32
+#define PALETTE_SHADES 8
+#define SHADE_BASE 4            // Unlit shade, 0..3 shadow, 5..7 light
+
+// DawnBringer-32 entries, same order as dbPalette[]
+typedef enum {
+    PAL_BLACK, PAL_VALHALLA, PAL_LOULOU, PAL_OILED_CEDAR, PAL_ROPE, PAL_TAHITI_GOLD, PAL_TWINE, PAL_PANCHO,
+    PAL_GOLDEN_FIZZ, PAL_ATLANTIS, PAL_CHRISTI, PAL_ELF_GREEN, PAL_DELL, PAL_VERDUN_GREEN, PAL_OPAL, PAL_DEEP_KOAMARU,
+    PAL_VENICE_BLUE, PAL_ROYAL_BLUE, PAL_KURT, PAL_WIND_BLUE, PAL_LINK_WATER, PAL_WHITE, PAL_SILVER, PAL_IRON,
+    PAL_SHUTTLE_GREY, PAL_CASCADE, PAL_MING, PAL_MOZART, PAL_OLD_ROSE, PAL_MAUVELOUS, PAL_APPLE_BLOSSOM, PAL_SAPLING
+} PaletteColor;
+
+extern const Color dbPalette[PALETTE_SIZE];
+extern Color paletteColors[PALETTE_SIZE * PALETTE_SHADES];
+
+void InitPalette(void);
+
+// Nearest palette entry (any shade) for an arbitrary color
+unsigned char PaletteIndex(Color color);
+
+// Shade for a terrain lighting value (slope * strength, see terrain.c)
+int ShadeForLight(int lightVal);
+
+static inline unsigned char ShadeIndex(PaletteColor color, int shade) {
+    return (unsigned char)(color * PALETTE_SHADES + shade);
+}
+
+#endif // PALETTE_H
@@ -0,0 +1,47 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+// Counter-based random numbers: every value is a pure hash of a key and a
+// counter, so there is no shared state. The same (seed, stream, counter)
+// always gives the same value on any thread and in any order.
+//
+// Typical use: derive a key once from the world seed and a stream, then
+// draw with a counter that identifies the value (pixel index, attempt, ...).
+
+// Systems drawing random numbers from the world seed
+typedef enum {
+    RANDOM_STREAM_NOISE,      // Perlin offsets
+    RANDOM_STREAM_TERRAIN,    // Terrain classification, keyed by texel
+    RANDOM_STREAM_MODEL,      // Model choice per spawned entity
+    RANDOM_STREAM_ENTITY,     // Per-entity streams (speed, heading, bounces)
+    RANDOM_STREAM_CHURN,      // Bench despawn picks
+    RANDOM_STREAM_SPAWN       // Spawn positions, + EntityType
+} RandomStream;
+
+// 32-bit integer finalizer (lowbias32), full avalanche
+static inline uint32_t RandomMix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x7feb352dU;
+    h ^= h >> 15;
+    h *= 0x846ca68bU;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline uint32_t RandomKey(uint32_t seed, uint32_t stream) {
+    return RandomMix(seed ^ RandomMix(stream + 0x9e3779b9U));
+}
+
+static inline uint32_t RandomHash(uint32_t key, uint32_t counter) {
+    return RandomMix(key ^ RandomMix(counter));
+}
+
+// Integer in [min, max], both inclusive (same contract as GetRandomValue)
+static inline int RandomRange(uint32_t key, uint32_t counter, int min, int max) {
+    uint32_t span = (uint32_t)(max - min) + 1U;
+    return min + (int)(((uint64_t)RandomHash(key, counter) * span) >> 32);
+}
+
+#endif // RANDOM_H
@@ -1,45 +1,261 @@
 #include "renderer.h"
 #include "settings.h"
+#include "jobs.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
-void InitRenderer(Renderer *renderer) {
-  renderer->frameBuffer = (Color*)malloc(GAME_WIDTH * GAME_HEIGHT * sizeof(Color));
+// Expands the palette once per fog level, blended from the plain colors
+// (level 0) to the clear color (last level)
+static void BuildFogPalettes(Renderer *renderer) {
+  Color sky = paletteColors[renderer->clear_index];
+  for (int level = 0; level < FOG_LEVELS; level++) {
+    int t = (level * 256) / (FOG_LEVELS - 1);
+    Color *palette = renderer->fog_palettes + level * PALETTE_SIZE * PALETTE_SHADES;
+    for (int i = 0; i < PALETTE_SIZE * PALETTE_SHADES; i++) {
+      Color c = paletteColors[i];
+      palette[i] = (Color){
+        (unsigned char)(c.r + (sky.r - c.r) * t / 256),
+        (unsigned char)(c.g + (sky.g - c.g) * t / 256),
+        (unsigned char)(c.b + (sky.b - c.b) * t / 256),
+        255
+      };
+    }
+  }
+  renderer->fog_index = renderer->clear_index;
+}
 
-  Image blank = GenImageColor(GAME_WIDTH, GAME_HEIGHT, BLACK);
-  renderer->screenTexture = LoadTextureFromImage(blank);
-  UnloadImage(blank);
+// Fog start and steps out to the farthest plane
+static void UpdateFog(Renderer *renderer) {
+  if (renderer->fog_index != renderer->clear_index) BuildFogPalettes(renderer);
+
+  float start = renderer->planesReach * renderer->fogStart;
+  int range = (int)(renderer->planesReach - start);
+  renderer->fog_start = (int)start;
+  renderer->fog_range = (range > 1) ? range : 1;
+  renderer->fog_mul = ((FOG_LEVELS - 1) << 16) / renderer->fog_range;
+}
+
+// Expanded palette for a pixel at the given depth
+static inline const Color *FogPalette(const Renderer *renderer, unsigned short depth) {
+  int d = depth - renderer->fog_start;
+  if (d <= 0) return renderer->fog_palettes;
+  if (d >= renderer->fog_range) return renderer->fog_palettes + (FOG_LEVELS - 1) * PALETTE_SIZE * PALETTE_SHADES;
+  return renderer->fog_palettes + ((d * renderer->fog_mul) >> 16) * PALETTE_SIZE * PALETTE_SHADES;
+}
 
-  SetTextureFilter(renderer->screenTexture, TEXTURE_FILTER_POINT);
+void InitRenderer(Renderer *renderer) {
+  int width = gameSettings.renderWidth;
+  int height = gameSettings.renderHeight;
 
-  for(int i=1; i<MAX_PLANES; i++){
-    renderer->depth_scale_table[i] = MAP_Z_SCALE / (float)i;
+  // Negative size means "native": render at the window resolution
+  if (width < 0 || height < 0) {
+    width = gameSettings.headless ? 0 : GetScreenWidth();
+    height = gameSettings.headless ? 0 : GetScreenHeight();
+  }
+  if (width <= 0 || height <= 0) {
+    width = GAME_WIDTH;
+    height = GAME_HEIGHT;
   }
+  // Buffers are never smaller than the smallest resolution rendered
+  if (width < MIN_RENDER_WIDTH) width = MIN_RENDER_WIDTH;
+  if (height < MIN_RENDER_HEIGHT) height = MIN_RENDER_HEIGHT;
+
+  renderer->maxWidth = width;
+  renderer->maxHeight = height;
+  renderer->frameBuffer = (Color*)malloc(width * height * sizeof(Color));
+  renderer->indexBuffer = (unsigned char*)malloc(width * height);
+  renderer->y_buffer = (int*)malloc(width * sizeof(int));
+  renderer->depthBuffer = (unsigned short*)malloc(width * height * sizeof(unsigned short));
+  renderer->fog_palettes = (Color*)malloc(FOG_LEVELS * PALETTE_SIZE * PALETTE_SHADES * sizeof(Color));
+  renderer->columnMajor = true;
+  renderer->terrainMips = true;
+  renderer->mode = (gameSettings.rayMarch || gameSettings.fog) ? RENDER_RAYS : RENDER_PLANES;
+  renderer->fog = gameSettings.fog;
+  renderer->fogStart = DEFAULT_FOG_START;
+
+  // Headless runs only fill the frame buffer, there is no GL context
+  renderer->screenTexture = (Texture2D){ 0 };
+  if (!gameSettings.headless) {
+    Image blank = GenImageColor(width, height, BLACK);
+    renderer->screenTexture = LoadTextureFromImage(blank);
+    UnloadImage(blank);
+
+    SetTextureFilter(renderer->screenTexture, TEXTURE_FILTER_POINT);
+  }
+
+  renderer->planeGrowth = (gameSettings.planeGrowth != 0.0f) ? gameSettings.planeGrowth : DEFAULT_PLANE_GROWTH;
+  renderer->planesDistance = (gameSettings.drawDistance > 0.0f) ? gameSettings.drawDistance : DEFAULT_DRAW_DISTANCE;
+  renderer->plane_count = 0;
 
+  renderer->dynamicResolution = gameSettings.dynamicResolution;
+  renderer->targetRenderMs = (gameSettings.targetRenderMs > 0.0f) ? gameSettings.targetRenderMs : DEFAULT_TARGET_RENDER_MS;
+  renderer->renderScale = 1.0f;
+  renderer->renderMs = 0.0f;
+
+  SetRenderResolution(renderer, width, height);
+
+  InitPalette();
   renderer->sky_color = DB_BLACK;
+  renderer->clear_index = PaletteIndex(renderer->sky_color);
+  BuildFogPalettes(renderer);
+}
+
+// Distances of the planes out to drawDistance. Each step is the larger of
+// 1 texel and planeGrowth * distance (Comanche-style dz), so far terrain
+// takes a fraction of the planes at about the same screen-space density.
+// Each plane samples the mip level matching its footprint: the larger of
+// the spacing between LOD groups (2z * step / width) and to the next plane.
+// The list holds at most MAX_PLANES, a longer one is cut short (with a
+// warning, once per draw distance) and planesReach records how far it goes.
+static void BuildPlanes(Renderer *renderer, float drawDistance) {
+  bool wasCut = (renderer->plane_count >= MAX_PLANES && renderer->planesDistance == drawDistance);
+  int count = 0;
+  float z = 1.0f;
+  while (z <= drawDistance && count < MAX_PLANES) {
+    float dz = z * renderer->planeGrowth;
+    if (dz < 1.0f) dz = 1.0f;
+
+    int step = 1 + ((int)z / LOD_FACTOR);
+    float footprint = 2.0f * z * step / renderer->width;
+    if (dz > footprint) footprint = dz;
+    int level = 0;
+    while (level < TERRAIN_MIP_LEVELS && (float)(2 << level) <= footprint) level++;
+
+    renderer->plane_z[count] = z;
+    renderer->depth_scale_table[count] = MAP_Z_SCALE * renderer->verticalScale / z;
+    renderer->plane_level[count] = (unsigned char)level;
+    count++;
+    z += dz;
+  }
+  renderer->plane_count = count;
+  renderer->planesDistance = drawDistance;
+  renderer->planesReach = (count > 0) ? renderer->plane_z[count - 1] : 0.0f;
+
+  if (z <= drawDistance && !wasCut) {
+    TraceLog(LOG_WARNING, "RENDERER: %d planes reach %.0f of draw distance %.0f, raise --plane-growth",
+             MAX_PLANES, renderer->planesReach, drawDistance);
+  }
+}
+
+void SetRenderResolution(Renderer *renderer, int width, int height) {
+  // The buffers' size bounds the result last, whatever was asked for
+  if (width < MIN_RENDER_WIDTH) width = MIN_RENDER_WIDTH;
+  if (height < MIN_RENDER_HEIGHT) height = MIN_RENDER_HEIGHT;
+  if (width > renderer->maxWidth) width = renderer->maxWidth;
+  if (height > renderer->maxHeight) height = renderer->maxHeight;
+
+  renderer->width = width;
+  renderer->height = height;
+  renderer->verticalScale = (float)height / GAME_HEIGHT;
+
+  BuildPlanes(renderer, renderer->planesDistance);
+}
+
+// Nudges the render scale towards the frame budget using last frame's
+// smoothed render time. Runs before a frame so the texture upload and the
+// picker always see the resolution the frame was rendered at.
+static void UpdateDynamicResolution(Renderer *renderer) {
+  if (renderer->renderMs <= 0.0f) return;
+
+  float scale = renderer->renderScale;
+  if (renderer->renderMs > renderer->targetRenderMs * 1.05f) scale *= 0.95f;
+  else if (renderer->renderMs < renderer->targetRenderMs * 0.80f) scale *= 1.02f;
+
+  if (scale < MIN_RENDER_SCALE) scale = MIN_RENDER_SCALE;
+  if (scale > 1.0f) scale = 1.0f;
+  renderer->renderScale = scale;
+
+  int width = (int)(renderer->maxWidth * scale) & ~7;
+  int height = (int)(renderer->maxHeight * scale) & ~1;
+  if (width != renderer->width || height != renderer->height) {
+    SetRenderResolution(renderer, width, height);
+  }
 }
 
 void ClearFrameBuffer(Renderer *renderer, Color color) {
-  for (int i = 0; i < GAME_WIDTH * GAME_HEIGHT; i++) {
-    renderer->frameBuffer[i] = color;
+  // Rendering fills whatever is left above the horizon with the clear
+  // color while resolving, no need to touch the whole buffer here.
+  renderer->clear_index = PaletteIndex(color);
+}
+
+typedef struct {
+  Renderer *renderer;
+  const EngineState *state;
+  const Terrain *terrain;
+  const TerrainOverlay *overlay;
+} RenderJob;
+
+// A strip's occlusion groups are tracked in one bit mask each
+#if (RENDER_STRIP_WIDTH >> OCCLUSION_GROUP_SHIFT) > 32
+#error "RENDER_STRIP_WIDTH / OCCLUSION_GROUP must fit in 32 bits"
+#endif
+
+// Recomputes the horizon of occlusion group g: the lowest (largest)
+// y_buffer entry of its columns, the only one a plane can still draw above.
+static void UpdateGroupHorizon(const Renderer *renderer, int *group_horizon, int x_start, int x_end, int g) {
+  int x0 = x_start + (g << OCCLUSION_GROUP_SHIFT);
+  int x1 = (x0 + OCCLUSION_GROUP < x_end) ? x0 + OCCLUSION_GROUP : x_end;
+  int lowest = 0;
+  for (int x = x0; x < x1; x++) {
+    if (renderer->y_buffer[x] > lowest) lowest = renderer->y_buffer[x];
   }
+  group_horizon[g] = lowest;
 }
 
-void DrawVertexSpace(Renderer *renderer, const EngineState *state, const Terrain *terrain) {
-  for (int i = 0; i < GAME_WIDTH; i++) {
-    renderer->y_buffer[i] = GAME_HEIGHT;
+// Renders screen columns [x_start, x_end) through all planes.
+// Each strip owns its slice of y_buffer and its frame buffer columns,
+// so strips can run on separate threads without synchronization.
+//
+// Occlusion: nothing on a plane projects higher than the tallest texel
+// (top_y). Occlusion groups whose horizon is at or above top_y are jumped
+// over without sampling, planes no group can see are skipped, and the
+// strip stops once every column is closed.
+static void DrawVertexSpaceStrip(Renderer *renderer, const EngineState *state, const Terrain *terrain, const TerrainOverlay *overlay, int x_start, int x_end) {
+  int width = renderer->width;
+  int height = renderer->height;
+  float horizon = state->horizon * renderer->verticalScale;
+
+  for (int i = x_start; i < x_end; i++) {
+    renderer->y_buffer[i] = height;
   }
 
+  int group_count = ((x_end - x_start) + OCCLUSION_GROUP - 1) >> OCCLUSION_GROUP_SHIFT;
+  int group_horizon[(RENDER_STRIP_WIDTH + OCCLUSION_GROUP - 1) >> OCCLUSION_GROUP_SHIFT];
+  for (int g = 0; g < group_count; g++) group_horizon[g] = height;
+  unsigned int dirty_groups = 0;   // Groups drawn into on the last plane
+
+  int max_h = terrain->maxHeight;
+  if (overlay && overlay->maxHeight > max_h) max_h = overlay->maxHeight;
+  float top_dz = state->camera_z - max_h;
+
   float pleft_x, pleft_y, pright_x, pright_y;
 
-  for (int p = 1; p < MAX_PLANES; p++)
+  for (int p = 0; p < renderer->plane_count; p++)
   {
-    int step = 1 + (p / LOD_FACTOR);
+    // Columns whose horizon is at or above top_y cannot change on this
+    // plane (and y_buffer 0 never can)
+    int top_y = (int)(top_dz * renderer->depth_scale_table[p] + horizon);
+    if (top_y < 0) top_y = 0;
+
+    for (int g = 0; dirty_groups; g++, dirty_groups >>= 1) {
+      if (dirty_groups & 1u) UpdateGroupHorizon(renderer, group_horizon, x_start, x_end, g);
+    }
 
-    pleft_x = (-state->cosphi * p - state->sinphi * p) + state->camera_x;
-    pleft_y = (state->sinphi * p - state->cosphi * p) + state->camera_y;
-    pright_x = (state->cosphi * p - state->sinphi * p) + state->camera_x;
-    pright_y = (-state->sinphi * p - state->cosphi * p) + state->camera_y;
+    int strip_horizon = 0;
+    for (int g = 0; g < group_count; g++) {
+      if (group_horizon[g] > strip_horizon) strip_horizon = group_horizon[g];
+    }
+    if (strip_horizon == 0) break;  // Every column closed
+    if (strip_horizon <= top_y) continue;
+
+    float z = renderer->plane_z[p];
+    int step = 1 + ((int)z / LOD_FACTOR);
+
+    pleft_x = (-state->cosphi * z - state->sinphi * z) + state->camera_x;
+    pleft_y = (state->sinphi * z - state->cosphi * z) + state->camera_y;
+    pright_x = (state->cosphi * z - state->sinphi * z) + state->camera_x;
+    pright_y = (-state->sinphi * z - state->cosphi * z) + state->camera_y;
 
     // Convert to fixed-point for faster coordinate calculations
     int pleft_x_fixed = (int)(pleft_x * FIXED_POINT_SCALE);
@@ -47,60 +263,93 @@ void DrawVertexSpace(Renderer *renderer, const EngineState *state, const Terrain
     int pright_x_fixed = (int)(pright_x * FIXED_POINT_SCALE);
     int pright_y_fixed = (int)(pright_y * FIXED_POINT_SCALE);
 
-    int base_dx_fixed = (pright_x_fixed - pleft_x_fixed) / GAME_WIDTH;
-    int base_dy_fixed = (pright_y_fixed - pleft_y_fixed) / GAME_WIDTH;
+    int base_dx_fixed = (pright_x_fixed - pleft_x_fixed) / width;
+    int base_dy_fixed = (pright_y_fixed - pleft_y_fixed) / width;
 
     int map_dx_fixed = base_dx_fixed * step;
     int map_dy_fixed = base_dy_fixed * step;
 
-    int cur_map_x_fixed = pleft_x_fixed;
-    int cur_map_y_fixed = pleft_y_fixed;
+    // One mip texel stands for the terrain between samples instead of
+    // aliasing, and far levels stay in cache
+    int level = renderer->terrainMips ? renderer->plane_level[p] : 0;
+    if (level > terrain->mipLevels) level = terrain->mipLevels;
+
+    // LOD groups stay aligned to the full screen, a group crossing the
+    // strip edge is clipped to the strip.
+    int first_x = (x_start / step) * step;
 
-    for (int screen_x = 0; screen_x < GAME_WIDTH; screen_x += step)
+    int cur_map_x_fixed = pleft_x_fixed + base_dx_fixed * first_x;
+    int cur_map_y_fixed = pleft_y_fixed + base_dy_fixed * first_x;
+
+    for (int screen_x = first_x; screen_x < x_end; screen_x += step)
     {
-      int fill_width = (screen_x + step > GAME_WIDTH) ? (GAME_WIDTH - screen_x) : step;
+      int fill_x = (screen_x < x_start) ? x_start : screen_x;
+      int fill_width = (screen_x + step > x_end) ? (x_end - fill_x) : (screen_x + step - fill_x);
+
+      // Closed occlusion group: continue with the LOD group holding the
+      // first column of the next open one
+      int g = (fill_x - x_start) >> OCCLUSION_GROUP_SHIFT;
+      if (group_horizon[g] <= top_y && ((fill_x + fill_width - 1 - x_start) >> OCCLUSION_GROUP_SHIFT) == g) {
+        while (g < group_count && group_horizon[g] <= top_y) g++;
+        if (g == group_count) break;
+        int next_x = first_x + ((x_start + (g << OCCLUSION_GROUP_SHIFT) - first_x) / step) * step;
+        int skipped = (next_x - screen_x) / step;
+        cur_map_x_fixed += map_dx_fixed * skipped;
+        cur_map_y_fixed += map_dy_fixed * skipped;
+        screen_x = next_x - step;
+        continue;
+      }
 
-      int lowest_horizon = renderer->y_buffer[screen_x];
-      if (step > 1) {
+      int lowest_horizon = renderer->y_buffer[fill_x];
+      if (fill_width > 1) {
           for (int k = 1; k < fill_width; k++) {
-              if (renderer->y_buffer[screen_x + k] > lowest_horizon) {
-                  lowest_horizon = renderer->y_buffer[screen_x + k];
+              if (renderer->y_buffer[fill_x + k] > lowest_horizon) {
+                  lowest_horizon = renderer->y_buffer[fill_x + k];
               }
           }
       }
 
-      if (lowest_horizon <= 0) {
+      if (lowest_horizon <= top_y) {
           cur_map_x_fixed += map_dx_fixed;
           cur_map_y_fixed += map_dy_fixed;
           continue;
       }
 
-      int map_x_int = (cur_map_x_fixed >> FIXED_POINT_SHIFT) & (gameSettings.mapSize - 1);
-      int map_y_int = (cur_map_y_fixed >> FIXED_POINT_SHIFT) & (gameSettings.mapSize - 1);
-      int index = map_y_int * gameSettings.mapSize + map_x_int;
-
-      int height = terrain->heightmapRaw[index];
-      int screen_y = (int)((state->camera_z - height) * renderer->depth_scale_table[p] + state->horizon);
+      int map_x_int = (cur_map_x_fixed >> FIXED_POINT_SHIFT) & terrain->mask;
+      int map_y_int = (cur_map_y_fixed >> FIXED_POINT_SHIFT) & terrain->mask;
+      TerrainTexel texel = SampleTerrainLevel(terrain, overlay, level, map_x_int, map_y_int);
+      int terrain_h = TexelHeight(texel);
+      int screen_y = (int)((state->camera_z - terrain_h) * renderer->depth_scale_table[p] + horizon);
 
       if (screen_y < lowest_horizon){
         if (screen_y < 0) screen_y = 0;
         int draw_height = lowest_horizon - screen_y;
 
         if (draw_height > 0){
-          Color col = terrain->colormapData[index];
+          unsigned char col = TexelColorIndex(texel);
 
-          int base_offset = screen_y * GAME_WIDTH + screen_x;
-          for (int k = 0; k < fill_width; k++) {
-            int offset = base_offset + k;
-            for (int y = screen_y; y < lowest_horizon; y++) {
-              renderer->frameBuffer[offset] = col;
-              offset += GAME_WIDTH;
+          if (renderer->columnMajor) {
+            // Each span is one contiguous run in the transposed buffer
+            for (int k = 0; k < fill_width; k++) {
+              unsigned char *span = renderer->indexBuffer + (fill_x + k) * height;
+              memset(span + screen_y, col, lowest_horizon - screen_y);
+            }
+          } else {
+            int base_offset = screen_y * width + fill_x;
+            for (int k = 0; k < fill_width; k++) {
+              int offset = base_offset + k;
+              for (int y = screen_y; y < lowest_horizon; y++) {
+                renderer->indexBuffer[offset] = col;
+                offset += width;
+              }
             }
           }
 
           for (int k = 0; k < fill_width; k++) {
-            renderer->y_buffer[screen_x + k] = screen_y;
+            renderer->y_buffer[fill_x + k] = screen_y;
           }
+          int g_last = (fill_x + fill_width - 1 - x_start) >> OCCLUSION_GROUP_SHIFT;
+          dirty_groups |= (2u << g_last) - (1u << g);
         }
       }
 
@@ -110,53 +359,351 @@ void DrawVertexSpace(Renderer *renderer, const EngineState *state, const Terrain
   }
 }
 
+// Empty-space skipping for rays. Mip texels hold the max height of their
+// 2^level block, so a block whose max stays below the lowest height a ray
+// could still see over its stretch through the block is jumped over.
+typedef struct {
+  float dx, dy;            // Map texels per unit of distance
+  float inv_dx, inv_dy;    // Distance per map texel, 0 if the ray is parallel to the axis
+  float horizon;           // Screen row of the horizon line
+  float rise_scale;        // Height per row per unit of distance
+  int max_height;          // Root of the hierarchy: terrain and overlay max
+  int level;               // Block level SkipBlock tests next
+  int wait;                // Hidden samples to let pass before the next test
+  int backoff;             // Next wait after a miss at the finest level
+} Ray;
+
+// Ray through screen column x
+static void InitRay(Ray *ray, const Renderer *renderer, const EngineState *state, const Terrain *terrain, const TerrainOverlay *overlay, int x) {
+  float pleft_rel_x = -state->cosphi - state->sinphi;
+  float pleft_rel_y = state->sinphi - state->cosphi;
+
+  float pright_rel_x = state->cosphi - state->sinphi;
+  float pright_rel_y = -state->sinphi - state->cosphi;
+
+  float dx = (pright_rel_x - pleft_rel_x) / renderer->width;
+  float dy = (pright_rel_y - pleft_rel_y) / renderer->width;
+
+  ray->dx = pleft_rel_x + dx * x;
+  ray->dy = pleft_rel_y + dy * x;
+  ray->inv_dx = (fabsf(ray->dx) > 1e-6f) ? 1.0f / ray->dx : 0.0f;
+  ray->inv_dy = (fabsf(ray->dy) > 1e-6f) ? 1.0f / ray->dy : 0.0f;
+  ray->horizon = state->horizon * renderer->verticalScale;
+  ray->rise_scale = 1.0f / (MAP_Z_SCALE * renderer->verticalScale);
+  ray->max_height = terrain->maxHeight;
+  if (overlay && overlay->maxHeight > ray->max_height) ray->max_height = overlay->maxHeight;
+  ray->level = RAY_SKIP_MIN_LEVEL;
+  ray->wait = 0;
+  ray->backoff = 1;
+}
+
+// Map position of the ray at distance z. Sampling and skipping must agree
+// on it to the last bit.
+static inline void RayPosition(const EngineState *state, const Ray *ray, float z, float *map_x, float *map_y) {
+  *map_x = state->camera_x + ray->dx * z;
+  *map_y = state->camera_y + ray->dy * z;
+}
+
+// Mip level the ray samples plane p at (0: full resolution)
+static inline int RayPlaneLevel(const Renderer *renderer, const Terrain *terrain, int p, bool mips) {
+  if (!mips) return 0;
+  int level = renderer->plane_level[p];
+  return (level < terrain->mipLevels) ? level : terrain->mipLevels;
+}
+
+// Whether the overlay has a tile in the 2^level block holding (x, y)
+static bool OverlayInBlock(const TerrainOverlay *overlay, int level, int x, int y) {
+  if (overlay->usedCount == 0) return false;
+  int tiles = (level > OVERLAY_TILE_SHIFT) ? 1 << (level - OVERLAY_TILE_SHIFT) : 1;
+  int tile_x = ((x >> level) << level) >> OVERLAY_TILE_SHIFT;
+  int tile_y = ((y >> level) << level) >> OVERLAY_TILE_SHIFT;
+  for (int ty = tile_y; ty < tile_y + tiles; ty++) {
+    for (int tx = tile_x; tx < tile_x + tiles; tx++) {
+      if (overlay->tileSlot[(ty << overlay->tileRowShift) + tx] >= 0) return true;
+    }
+  }
+  return false;
+}
+
+// Tries to move the ray from plane p, at (map_x, map_y) on texel (x, y),
+// out of the surrounding ray->level block. Returns the first plane past
+// the block, or p if the block may reach above y_limit. The lowest
+// visible height is linear in the distance, so testing both ends of the
+// ray's stretch through the block is enough. The level climbs after a
+// skip and drops after a miss, never below the level planes sample at (a
+// coarser texel reaches out of the block). Misses at the finest level
+// back off exponentially, a test costs about as much as a sample.
+static int SkipBlock(const Renderer *renderer, const EngineState *state, const Terrain *terrain, const TerrainOverlay *overlay,
+                     Ray *ray, int p, float map_x, float map_y, int x, int y, int y_limit, bool mips) {
+  float z = renderer->plane_z[p];
+  float rise = (y_limit - ray->horizon) * ray->rise_scale;
+
+  // Root of the hierarchy: nothing left on the ray can be tall enough
+  float last_z = renderer->plane_z[renderer->plane_count - 1];
+  if ((float)ray->max_height < state->camera_z - rise * ((rise > 0.0f) ? last_z : z) - 1.0f) {
+    return renderer->plane_count;
+  }
+
+  int min_level = RayPlaneLevel(renderer, terrain, p, mips);
+  if (min_level < RAY_SKIP_MIN_LEVEL) min_level = RAY_SKIP_MIN_LEVEL;
+  if (min_level > terrain->mipLevels) return p;
+  int level = (ray->level > min_level) ? ray->level : min_level;
+
+  // Distance where the ray leaves the block, pulled in a little so the
+  // rounding of later positions cannot land past the edge
+  float exit_z = z + renderer->planesReach;
+  if (ray->inv_dx != 0.0f) {
+    float local_x = (float)x + (map_x - floorf(map_x));
+    float edge_x = (float)(((x >> level) + (ray->dx > 0.0f)) << level);
+    float t = (edge_x - local_x - copysignf(0.01f, ray->dx)) * ray->inv_dx;
+    if (z + t < exit_z) exit_z = z + t;
+  }
+  if (ray->inv_dy != 0.0f) {
+    float local_y = (float)y + (map_y - floorf(map_y));
+    float edge_y = (float)(((y >> level) + (ray->dy > 0.0f)) << level);
+    float t = (edge_y - local_y - copysignf(0.01f, ray->dy)) * ray->inv_dy;
+    if (z + t < exit_z) exit_z = z + t;
+  }
+
+  // Lowest visible height over [z, exit_z], with a margin for rounding
+  float need = state->camera_z - rise * ((rise > 0.0f) ? exit_z : z) - 1.0f;
+
+  int block_max = TexelHeight(TerrainMipTexel(terrain, level, x, y));
+  if (overlay && overlay->maxHeight > block_max && OverlayInBlock(overlay, level, x, y)) {
+    block_max = overlay->maxHeight;
+  }
+
+  int q = p;
+  if ((float)block_max < need) {
+    while (q < renderer->plane_count && renderer->plane_z[q] < exit_z && RayPlaneLevel(renderer, terrain, q, mips) <= level) q++;
+  }
+
+  if (q > p) {
+    if (level < terrain->mipLevels) level++;
+    ray->backoff = 1;
+  } else if (level > min_level) {
+    level--;
+  } else {
+    ray->wait = ray->backoff - 1;
+    if (ray->backoff < RAY_SKIP_BACKOFF) ray->backoff *= 2;
+  }
+  ray->level = level;
+  return q;
+}
+
+// Renders screen columns [x_start, x_end) in RENDER_RAYS mode: every
+// column marches its own ray through the planes, sampling the terrain at
+// its own position (no LOD groups), and writes the distance of what it
+// draws into the depth buffer. After a sample hidden well below the
+// column's horizon the ray tries to skip the empty space ahead on the
+// mips. Entities painted into the texels are not in the mips, nothing is
+// skipped then.
+static void DrawRayStrip(Renderer *renderer, const EngineState *state, const Terrain *terrain, const TerrainOverlay *overlay, int x_start, int x_end) {
+  int width = renderer->width;
+  int height = renderer->height;
+  float horizon = state->horizon * renderer->verticalScale;
+  bool mips = renderer->terrainMips;
+  bool skip = !gameSettings.paintIntoTerrain;
+
+  for (int x = x_start; x < x_end; x++) {
+    Ray ray;
+    InitRay(&ray, renderer, state, terrain, overlay, x);
+    int y_limit = height;
+    bool hidden = false;   // The last sample was RAY_SKIP_MARGIN below y_limit
+
+    int p = 0;
+    while (p < renderer->plane_count) {
+      float map_x, map_y;
+      RayPosition(state, &ray, renderer->plane_z[p], &map_x, &map_y);
+      int map_x_int = (int)floorf(map_x) & terrain->mask;
+      int map_y_int = (int)floorf(map_y) & terrain->mask;
+
+      if (hidden && skip && ray.wait-- <= 0) {
+        int next = SkipBlock(renderer, state, terrain, overlay, &ray, p, map_x, map_y, map_x_int, map_y_int, y_limit, mips);
+        if (next != p) {
+          p = next;
+          continue;
+        }
+      }
+
+      TerrainTexel texel = SampleTerrainLevel(terrain, overlay, RayPlaneLevel(renderer, terrain, p, mips), map_x_int, map_y_int);
+      int screen_y = (int)((state->camera_z - TexelHeight(texel)) * renderer->depth_scale_table[p] + horizon);
+
+      hidden = (screen_y - y_limit) > RAY_SKIP_MARGIN * renderer->depth_scale_table[p];
+      if (screen_y < y_limit) {
+        if (screen_y < 0) screen_y = 0;
+        unsigned char col = TexelColorIndex(texel);
+        float z = renderer->plane_z[p];
+        unsigned short depth = (z < RENDER_DEPTH_SKY) ? (unsigned short)z : RENDER_DEPTH_SKY - 1;
+        if (renderer->columnMajor) {
+          memset(renderer->indexBuffer + x * height + screen_y, col, y_limit - screen_y);
+          unsigned short *span = renderer->depthBuffer + x * height;
+          for (int y = screen_y; y < y_limit; y++) span[y] = depth;
+        } else {
+          for (int y = screen_y; y < y_limit; y++) {
+            renderer->indexBuffer[y * width + x] = col;
+            renderer->depthBuffer[y * width + x] = depth;
+          }
+        }
+        y_limit = screen_y;
+        if (y_limit == 0) break;
+      }
+      p++;
+    }
+
+    renderer->y_buffer[x] = y_limit;
+  }
+}
+
+// Fills the sky above each column's final horizon and expands the strip's
+// palette indices into the RGBA frame buffer, transposing on the way when
+// the strip was rendered column-major. In RENDER_RAYS the sky also goes
+// into the depth buffer, and fog picks each pixel's palette by its depth.
+static void ResolveStrip(Renderer *renderer, int x_start, int x_end) {
+  int width = renderer->width;
+  int height = renderer->height;
+  const Color *lut = paletteColors;
+  bool depth = (renderer->mode == RENDER_RAYS);
+  bool fog = depth && renderer->fog;
+
+  if (renderer->columnMajor) {
+    for (int x = x_start; x < x_end; x++) {
+      memset(renderer->indexBuffer + x * height, renderer->clear_index, renderer->y_buffer[x]);
+      if (depth) memset(renderer->depthBuffer + x * height, 0xFF, renderer->y_buffer[x] * sizeof(unsigned short));
+    }
+
+    // Tiled transpose: every tile reads TRANSPOSE_TILE cache-friendly
+    // column runs and writes TRANSPOSE_TILE row runs.
+    for (int ty = 0; ty < height; ty += TRANSPOSE_TILE) {
+      int y_end = (ty + TRANSPOSE_TILE < height) ? ty + TRANSPOSE_TILE : height;
+      for (int tx = x_start; tx < x_end; tx += TRANSPOSE_TILE) {
+        int tile_x_end = (tx + TRANSPOSE_TILE < x_end) ? tx + TRANSPOSE_TILE : x_end;
+        for (int y = ty; y < y_end; y++) {
+          Color *row = renderer->frameBuffer + y * width;
+          if (fog) {
+            for (int x = tx; x < tile_x_end; x++) {
+              int i = x * height + y;
+              row[x] = FogPalette(renderer, renderer->depthBuffer[i])[renderer->indexBuffer[i]];
+            }
+          } else {
+            for (int x = tx; x < tile_x_end; x++) {
+              row[x] = lut[renderer->indexBuffer[x * height + y]];
+            }
+          }
+        }
+      }
+    }
+  } else {
+    for (int x = x_start; x < x_end; x++) {
+      for (int y = 0; y < renderer->y_buffer[x]; y++) {
+        renderer->indexBuffer[y * width + x] = renderer->clear_index;
+        if (depth) renderer->depthBuffer[y * width + x] = RENDER_DEPTH_SKY;
+      }
+    }
+
+    for (int y = 0; y < height; y++) {
+      const unsigned char *src = renderer->indexBuffer + y * width;
+      Color *row = renderer->frameBuffer + y * width;
+      if (fog) {
+        const unsigned short *src_depth = renderer->depthBuffer + y * width;
+        for (int x = x_start; x < x_end; x++) {
+          row[x] = FogPalette(renderer, src_depth[x])[src[x]];
+        }
+      } else {
+        for (int x = x_start; x < x_end; x++) {
+          row[x] = lut[src[x]];
+        }
+      }
+    }
+  }
+}
+
+static void RenderStripJob(void *data, int start, int end) {
+  RenderJob *job = (RenderJob*)data;
+
+  // LOD groups are clipped at strip edges, so the strips must be the same
+  // whether a batch covers one strip or the whole screen (single thread).
+  for (int x = start; x < end; x += RENDER_STRIP_WIDTH) {
+    int x_end = (x + RENDER_STRIP_WIDTH < end) ? x + RENDER_STRIP_WIDTH : end;
+    if (job->renderer->mode == RENDER_RAYS) {
+      DrawRayStrip(job->renderer, job->state, job->terrain, job->overlay, x, x_end);
+    } else {
+      DrawVertexSpaceStrip(job->renderer, job->state, job->terrain, job->overlay, x, x_end);
+    }
+    ResolveStrip(job->renderer, x, x_end);
+  }
+}
+
+void DrawVertexSpace(Renderer *renderer, const EngineState *state, const Terrain *terrain, const TerrainOverlay *overlay) {
+  if (renderer->dynamicResolution) UpdateDynamicResolution(renderer);
+  if (state->drawDistance != renderer->planesDistance) BuildPlanes(renderer, state->drawDistance);
+
+  double start = GetEngineTime();
+
+  if (renderer->fog) UpdateFog(renderer);
+
+  RenderJob job = { renderer, state, terrain, overlay };
+  RunParallel(RenderStripJob, &job, renderer->width, RENDER_STRIP_WIDTH);
+
+  float ms = (float)((GetEngineTime() - start) * 1000.0);
+  renderer->renderMs = (renderer->renderMs > 0.0f) ? renderer->renderMs * 0.9f + ms * 0.1f : ms;
+}
+
 void UpdateRendererTexture(Renderer *renderer) {
-  UpdateTexture(renderer->screenTexture, renderer->frameBuffer);
+  if (renderer->screenTexture.id == 0) return;
+  Rectangle rect = { 0.0f, 0.0f, (float)renderer->width, (float)renderer->height };
+  UpdateTextureRec(renderer->screenTexture, rect, renderer->frameBuffer);
 }
 
 void DrawRendererTextureToScreen(Renderer *renderer) {
   ClearBackground(BLACK);
-  Rectangle srcRect = { 0.0f, 0.0f, (float)GAME_WIDTH, (float)GAME_HEIGHT };
+  Rectangle srcRect = { 0.0f, 0.0f, (float)renderer->width, (float)renderer->height };
   Rectangle destRect = { 0.0f, 0.0f, (float)GetScreenWidth(), (float)GetScreenHeight() };
   DrawTexturePro(renderer->screenTexture, srcRect, destRect, (Vector2){ 0, 0 }, 0.0f, WHITE);
 }
 
 bool GetMapCoordinates(const Renderer *renderer, const EngineState *state, const Terrain *terrain, int screenX, int screenY, int *outMapX, int *outMapY) {
-  float scaleX = (float)GAME_WIDTH / GetScreenWidth();
-  float scaleY = (float)GAME_HEIGHT / GetScreenHeight();
+  float scaleX = (float)renderer->width / GetScreenWidth();
+  float scaleY = (float)renderer->height / GetScreenHeight();
 
   int gameX = (int)(screenX * scaleX);
   int gameY = (int)(screenY * scaleY);
 
-  if (gameX < 0 || gameX >= GAME_WIDTH || gameY < 0 || gameY >= GAME_HEIGHT) return false;
+  if (gameX < 0 || gameX >= renderer->width || gameY < 0 || gameY >= renderer->height) return false;
 
-  float pleft_rel_x = -state->cosphi - state->sinphi;
-  float pleft_rel_y = state->sinphi - state->cosphi;
+  Ray ray;
+  InitRay(&ray, renderer, state, terrain, NULL, gameX);
 
-  float pright_rel_x = state->cosphi - state->sinphi;
-  float pright_rel_y = -state->sinphi - state->cosphi;
+  int lowest_horizon = renderer->height;
+  float horizon = state->horizon * renderer->verticalScale;
+  bool skip = !gameSettings.paintIntoTerrain;
+  bool hidden = false;
 
-  float dx = (pright_rel_x - pleft_rel_x) / GAME_WIDTH;
-  float dy = (pright_rel_y - pleft_rel_y) / GAME_WIDTH;
+  // Samples that cannot rise above lowest_horizon are skipped on the mips
+  int p = 0;
+  while (p < renderer->plane_count) {
+    float mapX, mapY;
+    RayPosition(state, &ray, renderer->plane_z[p], &mapX, &mapY);
 
-  float ray_dx = pleft_rel_x + dx * gameX;
-  float ray_dy = pleft_rel_y + dy * gameX;
+    int map_x_int = ((int)floorf(mapX)) & terrain->mask;
+    int map_y_int = ((int)floorf(mapY)) & terrain->mask;
 
-  int lowest_horizon = GAME_HEIGHT;
-
-  for (int p = 1; p < MAX_PLANES; p++) {
-    float mapX = state->camera_x + ray_dx * p;
-    float mapY = state->camera_y + ray_dy * p;
+    if (hidden && skip) {
+      int next = SkipBlock(renderer, state, terrain, NULL, &ray, p, mapX, mapY, map_x_int, map_y_int, lowest_horizon, false);
+      if (next != p) {
+        p = next;
+        continue;
+      }
+    }
 
-    int map_x_int = ((int)mapX) & (gameSettings.mapSize - 1);
-    int map_y_int = ((int)mapY) & (gameSettings.mapSize - 1);
-    int index = map_y_int * gameSettings.mapSize + map_x_int;
+    int index = TerrainIndex(terrain, map_x_int, map_y_int);
 
-    int height = terrain->heightmapRaw[index];
+    int height = TexelHeight(terrain->texels[index]);
 
-    int projected_y = (int)((state->camera_z - height) * renderer->depth_scale_table[p] + state->horizon);
+    int projected_y = (int)((state->camera_z - height) * renderer->depth_scale_table[p] + horizon);
 
-    if (projected_y < lowest_horizon) {
+    hidden = (projected_y >= lowest_horizon);
+    if (!hidden) {
       if (gameY >= projected_y && gameY <= lowest_horizon) {
         *outMapX = map_x_int;
         *outMapY = map_y_int;
@@ -166,6 +713,7 @@ bool GetMapCoordinates(const Renderer *renderer, const EngineState *state, const
     }
 
     if (lowest_horizon < 0) break;
+    p++;
   }
 
   return false;
@@ -173,5 +721,9 @@ bool GetMapCoordinates(const Renderer *renderer, const EngineState *state, const
 
 void CloseRenderer(Renderer *renderer) {
   free(renderer->frameBuffer);
-  UnloadTexture(renderer->screenTexture);
+  free(renderer->indexBuffer);
+  free(renderer->y_buffer);
+  free(renderer->depthBuffer);
+  free(renderer->fog_palettes);
+  if (renderer->screenTexture.id != 0) UnloadTexture(renderer->screenTexture);
 }
@@ -5,18 +5,70 @@
 #include "constants.h"
 #include "engine.h"
 #include "terrain.h"
+#include "overlay.h"
+#include "palette.h"
+
+typedef enum {
+    RENDER_PLANES,   // Plane by plane across each strip, LOD groups far out
+    RENDER_RAYS      // Column by column, skipping empty space on the terrain mips
+} RenderMode;
+
+#define RENDER_DEPTH_SKY 0xFFFF   // depthBuffer value where no terrain was drawn
 
 typedef struct {
-    Color *frameBuffer;
+    Color *frameBuffer;           // RGBA, filled from indexBuffer through the palette
+    unsigned char *indexBuffer;   // Palette-indexed render target
+    bool columnMajor;             // indexBuffer is transposed (x * height + y)
+    bool terrainMips;             // Distant planes sample the terrain mips
+    RenderMode mode;
     Texture2D screenTexture;
-    int y_buffer[GAME_WIDTH];
+    int *y_buffer;
+
+    // RENDER_RAYS also writes the distance (plane_z, map texels) of every
+    // pixel, laid out like indexBuffer, and can fade it into the sky
+    unsigned short *depthBuffer;
+    bool fog;
+    float fogStart;         // Fraction of the draw distance the fog starts at
+    Color *fog_palettes;    // FOG_LEVELS expanded palettes, blended towards the sky
+    unsigned char fog_index;   // clear_index the palettes were built for
+    int fog_start;          // Per frame: fog start and range in map texels,
+    int fog_range;          // FOG_LEVELS - 1 steps over the range in 16.16
+    int fog_mul;
+
+    // Planes marched front to back: distance from the camera, projection
+    // scale and terrain mip level of each. Spacing is 1 texel up close and
+    // grows with the distance (planeGrowth), out to planesDistance.
+    float plane_z[MAX_PLANES];
     float depth_scale_table[MAX_PLANES];
+    unsigned char plane_level[MAX_PLANES];
+    int plane_count;
+    float planeGrowth;
+    float planesDistance;   // Draw distance the list was built for
+    float planesReach;      // Distance of the last plane, short of planesDistance if MAX_PLANES ran out
     Color sky_color;
+    unsigned char clear_index;
+
+    // Internal resolution. Buffers and texture are allocated at the
+    // maximum size, width/height is the part currently rendered.
+    int width;
+    int height;
+    int maxWidth;
+    int maxHeight;
+    float verticalScale;   // height / GAME_HEIGHT, keeps the projection resolution independent
+
+    // Dynamic resolution: scale width/height to hold DrawVertexSpace
+    // near targetRenderMs.
+    bool dynamicResolution;
+    float targetRenderMs;
+    float renderScale;     // Current fraction of the maximum resolution
+    float renderMs;        // Smoothed DrawVertexSpace time
 } Renderer;
 
 void InitRenderer(Renderer *renderer);
+void SetRenderResolution(Renderer *renderer, int width, int height);
 void ClearFrameBuffer(Renderer *renderer, Color color);
-void DrawVertexSpace(Renderer *renderer, const EngineState *state, const Terrain *terrain);
+// overlay (may be NULL) is drawn over the terrain, which is only read
+void DrawVertexSpace(Renderer *renderer, const EngineState *state, const Terrain *terrain, const TerrainOverlay *overlay);
 void UpdateRendererTexture(Renderer *renderer);
 void DrawRendererTextureToScreen(Renderer *renderer);
 bool GetMapCoordinates(const Renderer *renderer, const EngineState *state, const Terrain *terrain, int screenX, int screenY, int *outMapX, int *outMapY);
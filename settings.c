@@ -0,0 +1,32 @@
+#include "settings.h"
+
+GameSettings gameSettings;
+
+// Map size and entity counts for the sizes offered in the setup menu
+void ApplyMapPreset(int mapSize) {
+  gameSettings.mapSize = mapSize;
+  gameSettings.noiseScale = mapSize / 512.0f;
+
+  switch (mapSize) {
+    case 1024:
+      gameSettings.shipCount = 10;
+      gameSettings.unitCount = 40;
+      gameSettings.buildingCount = 20;
+      break;
+    case 2048:
+      gameSettings.shipCount = 20;
+      gameSettings.unitCount = 120;
+      gameSettings.buildingCount = 40;
+      break;
+    case 4096:
+      gameSettings.shipCount = 100;
+      gameSettings.unitCount = 250;
+      gameSettings.buildingCount = 80;
+      break;
+    default:
+      gameSettings.shipCount = 500;
+      gameSettings.unitCount = 1000;
+      gameSettings.buildingCount = 100;
+      break;
+  }
+}
@@ -1,6 +1,8 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <stdbool.h>
+
 typedef enum {
     MODE_GAME,
     MODE_EDITOR,
@@ -14,8 +16,29 @@ typedef struct {
     int shipCount;
     int unitCount;
     int buildingCount;
+    unsigned int seed;  // World seed: same seed, same map and spawns
+    bool worldCache;    // Load the world from / save it to the cache (world.h)
+    int entityCapacity; // Max live entities, 0 = MAX_ENTITIES
+    bool paintIntoTerrain; // Paint & Restore entities into the terrain instead of the overlay
+    int threadCount;   // Worker threads incl. main thread, 0 = one per core
+    bool headless;     // No window or GPU texture, render into the frame buffer only
+
+    // Internal render resolution, 0 = GAME_WIDTH x GAME_HEIGHT, -1 = window size
+    int renderWidth;
+    int renderHeight;
+    bool dynamicResolution;
+    float targetRenderMs;  // 0 = DEFAULT_TARGET_RENDER_MS
+
+    // Terrain planes: draw distance in map texels (0 = DEFAULT_DRAW_DISTANCE)
+    // and spacing growth (0 = DEFAULT_PLANE_GROWTH, < 0 = 1 texel everywhere)
+    float drawDistance;
+    float planeGrowth;
+    bool rayMarch;     // Render column by column (RENDER_RAYS) instead of plane by plane
+    bool fog;          // Distance fog, needs (and turns on) rayMarch
 } GameSettings;
 
 extern GameSettings gameSettings;
 
+void ApplyMapPreset(int mapSize);
+
 #endif // SETTINGS_H
\ No newline at end of file
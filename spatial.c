@@ -0,0 +1,68 @@
+#include "spatial.h"
+#include <stdlib.h>
+
+void InitEntityGrid(EntityGrid *grid, int mapSize, int capacity)
+{
+    grid->rowShift = 0;
+    while (((1 << ENTITY_GRID_CELL_SHIFT) << grid->rowShift) < mapSize) grid->rowShift++;
+    grid->cellMask = (1 << grid->rowShift) - 1;
+
+    int cellCount = 1 << (2 * grid->rowShift);
+    grid->cellHead = (int *)malloc(cellCount * sizeof(int));
+    for (int c = 0; c < cellCount; c++) grid->cellHead[c] = -1;
+
+    grid->next = (int *)malloc(capacity * sizeof(int));
+    grid->prev = (int *)malloc(capacity * sizeof(int));
+    grid->cell = (int *)malloc(capacity * sizeof(int));
+    for (int s = 0; s < capacity; s++) grid->cell[s] = -1;
+}
+
+void UnloadEntityGrid(EntityGrid *grid)
+{
+    free(grid->cellHead);
+    free(grid->next);
+    free(grid->prev);
+    free(grid->cell);
+    grid->cellHead = NULL;
+    grid->next = NULL;
+    grid->prev = NULL;
+    grid->cell = NULL;
+}
+
+static void LinkSlot(EntityGrid *grid, int slot, int cell)
+{
+    int head = grid->cellHead[cell];
+    grid->next[slot] = head;
+    grid->prev[slot] = -1;
+    if (head >= 0) grid->prev[head] = slot;
+    grid->cellHead[cell] = slot;
+    grid->cell[slot] = cell;
+}
+
+static void UnlinkSlot(EntityGrid *grid, int slot)
+{
+    int next = grid->next[slot];
+    int prev = grid->prev[slot];
+    if (prev >= 0) grid->next[prev] = next;
+    else grid->cellHead[grid->cell[slot]] = next;
+    if (next >= 0) grid->prev[next] = prev;
+    grid->cell[slot] = -1;
+}
+
+void EntityGridInsert(EntityGrid *grid, int slot, float x, float y)
+{
+    LinkSlot(grid, slot, EntityGridCellAt(grid, x, y));
+}
+
+void EntityGridRemove(EntityGrid *grid, int slot)
+{
+    if (grid->cell[slot] >= 0) UnlinkSlot(grid, slot);
+}
+
+void EntityGridMove(EntityGrid *grid, int slot, float x, float y)
+{
+    int cell = EntityGridCellAt(grid, x, y);
+    if (cell == grid->cell[slot]) return;
+    if (grid->cell[slot] >= 0) UnlinkSlot(grid, slot);
+    LinkSlot(grid, slot, cell);
+}
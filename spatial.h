@@ -0,0 +1,41 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include "constants.h"
+
+// Uniform grid over the map for entity lookups. Each cell holds an
+// intrusive doubly linked list of entity slots (see EntityHandle), so
+// inserting, removing and moving an entity between cells are O(1) and
+// never allocate. The grid wraps with the map.
+typedef struct {
+    int rowShift;     // log2(cells per row)
+    int cellMask;     // cells per row - 1
+    int *cellHead;    // First slot in each cell, -1 if empty
+    int *next;        // Per slot: next / previous slot in the same cell
+    int *prev;
+    int *cell;        // Per slot: cell it is linked into, -1 if none
+} EntityGrid;
+
+void InitEntityGrid(EntityGrid *grid, int mapSize, int capacity);
+void UnloadEntityGrid(EntityGrid *grid);
+
+static inline int EntityGridCellsPerRow(const EntityGrid *grid) {
+    return grid->cellMask + 1;
+}
+
+// Cell (cx, cy) in cell coordinates, wrapped
+static inline int EntityGridCell(const EntityGrid *grid, int cx, int cy) {
+    return ((cy & grid->cellMask) << grid->rowShift) | (cx & grid->cellMask);
+}
+
+// Cell holding map position (x, y)
+static inline int EntityGridCellAt(const EntityGrid *grid, float x, float y) {
+    return EntityGridCell(grid, (int)x >> ENTITY_GRID_CELL_SHIFT, (int)y >> ENTITY_GRID_CELL_SHIFT);
+}
+
+void EntityGridInsert(EntityGrid *grid, int slot, float x, float y);
+void EntityGridRemove(EntityGrid *grid, int slot);
+// Relinks slot only when (x, y) lies in another cell
+void EntityGridMove(EntityGrid *grid, int slot, float x, float y);
+
+#endif // SPATIAL_H
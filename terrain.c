@@ -1,160 +1,449 @@
+#define _POSIX_C_SOURCE 200809L
 #include "terrain.h"
 #include "settings.h"
+#include "engine.h"
+#include "jobs.h"
+#include "random.h"
 #include <stdlib.h>
+#include <stdio.h>
 #include <math.h>
 
-static void GenerateTerrainPixel(Color *colPixel, unsigned char *hPixel)
+// No mmap on Windows and the web build, world files are read instead
+#if !defined(_WIN32) && !defined(PLATFORM_WEB)
+#define TERRAIN_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Random draws per texel, each one gets its own counter
+#define TERRAIN_RANDOM_DRAWS 8
+
+// Random value number `draw` of the texel with counter base `cell`
+static inline int TexelRandom(uint32_t key, uint32_t cell, int draw, int min, int max)
+{
+  return RandomRange(key, cell * TERRAIN_RANDOM_DRAWS + draw, min, max);
+}
+
+static void GenerateTerrainPixel(unsigned char *colPixel, unsigned char *hPixel, uint32_t key, uint32_t cell)
 {
   unsigned char h = *hPixel;
+  PaletteColor col;
 
   if (h < LEVEL_WATER) {
     *hPixel = LEVEL_WATER;
-    if (h < LEVEL_WATER - 12) *colPixel = DB_VENICE_BLUE;
-    else *colPixel = DB_ROYAL_BLUE;
+    if (h < LEVEL_WATER - 12) col = PAL_VENICE_BLUE;
+    else col = PAL_ROYAL_BLUE;
+    *colPixel = ShadeIndex(col, SHADE_BASE);
     return;
   }
-  else if (h < LEVEL_SAND + GetRandomValue(-5, 15)) {
+  else if (h < LEVEL_SAND + TexelRandom(key, cell, 0, -5, 15)) {
     if (h < LEVEL_WATER + 4) {
-        *colPixel = DB_TWINE;
+        col = PAL_TWINE;
     } else {
-        *colPixel = DB_PANCHO;
+        col = PAL_PANCHO;
     }
   }
-  else if (h < LEVEL_GRASS_LOW + GetRandomValue(-10, 25)) {
-    *colPixel = (Color[]){DB_CHRISTI, DB_ELF_GREEN}[GetRandomValue(0, 1)];
+  else if (h < LEVEL_GRASS_LOW + TexelRandom(key, cell, 1, -10, 25)) {
+    col = (PaletteColor[]){PAL_CHRISTI, PAL_ELF_GREEN}[TexelRandom(key, cell, 2, 0, 1)];
   }
-  else if (h < LEVEL_GRASS_HIGH + GetRandomValue(-20, 50)) {
-    *colPixel = (Color[]){ DB_APPLE_BLOSSOM, DB_DELL, DB_VERDUN_GREEN, DB_SAPLING }[GetRandomValue(0, 3)];
-    *hPixel += GetRandomValue(0, 10);
+  else if (h < LEVEL_GRASS_HIGH + TexelRandom(key, cell, 3, -20, 50)) {
+    col = (PaletteColor[]){ PAL_APPLE_BLOSSOM, PAL_DELL, PAL_VERDUN_GREEN, PAL_SAPLING }[TexelRandom(key, cell, 4, 0, 3)];
+    *hPixel += TexelRandom(key, cell, 5, 0, 10);
   }
-  else if (h < LEVEL_ROCK + GetRandomValue(-10, 10)) {
-    *colPixel = DB_SHUTTLE_GREY;
+  else if (h < LEVEL_ROCK + TexelRandom(key, cell, 6, -10, 10)) {
+    col = PAL_SHUTTLE_GREY;
   }else {
-    *colPixel = DB_WHITE;
+    col = PAL_WHITE;
   }
+  *colPixel = ShadeIndex(col, SHADE_BASE);
 }
 
-void GenerateProceduralTerrain(Terrain *terrain)
+static void SetTerrainSize(Terrain *terrain, int size)
 {
-    // Note: DrawMessage moved to calling code to decouple UI from Logic
+    terrain->size = size;
+    terrain->mask = size - 1;
+    terrain->tileRowShift = 0;
+    while ((TERRAIN_TILE << terrain->tileRowShift) < size) terrain->tileRowShift++;
+    terrain->mapping = NULL;
+    terrain->mappingSize = 0;
 
-    int offsetX = GetRandomValue(0, 10000);
-    int offsetY = GetRandomValue(0, 10000);
+    terrain->mipLevels = 0;
+    while (terrain->mipLevels < TERRAIN_MIP_LEVELS && (size >> (terrain->mipLevels + 1)) > 0) terrain->mipLevels++;
+}
 
-    Image heightmap = GenImagePerlinNoise(gameSettings.mapSize, gameSettings.mapSize, offsetX, offsetY, gameSettings.noiseScale);
+size_t TerrainStorageTexels(int size)
+{
+    size_t count = (size_t)size * size;
+    for (int l = 1; l <= TERRAIN_MIP_LEVELS && (size >> l) > 0; l++) {
+        count += (size_t)(size >> l) * (size >> l);
+    }
+    return count;
+}
 
-    ImageFormat(&heightmap, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
-    Color *heightmapData = (Color*)heightmap.data;
+// Points the mip levels into the storage block after the texels
+static void SetTerrainMips(Terrain *terrain)
+{
+    TerrainTexel *next = terrain->texels + (size_t)terrain->size * terrain->size;
+    terrain->mips[0] = NULL;
+    for (int l = 1; l <= TERRAIN_MIP_LEVELS; l++) {
+        int edge = terrain->size >> l;
+        terrain->mips[l] = (l <= terrain->mipLevels) ? next : NULL;
+        if (l <= terrain->mipLevels) next += (size_t)edge * edge;
+    }
+}
 
-    terrain->heightmapRaw = (unsigned char *)malloc(gameSettings.mapSize * gameSettings.mapSize);
-    for (int i = 0; i < gameSettings.mapSize * gameSettings.mapSize; i++) {
-        terrain->heightmapRaw[i] = heightmapData[i].r;
+// Max height from the coarsest mip, which holds the max of everything
+static void UpdateTerrainMaxHeight(Terrain *terrain)
+{
+    if (terrain->mipLevels == 0) {
+        terrain->maxHeight = 255;
+        return;
+    }
+    int edge = terrain->size >> terrain->mipLevels;
+    const TerrainTexel *top = terrain->mips[terrain->mipLevels];
+    terrain->maxHeight = 0;
+    for (int i = 0; i < edge * edge; i++) {
+        if (TexelHeight(top[i]) > terrain->maxHeight) terrain->maxHeight = TexelHeight(top[i]);
     }
+}
+
+void AllocTerrain(Terrain *terrain, int size)
+{
+    SetTerrainSize(terrain, size);
+    terrain->texels = (TerrainTexel *)calloc(TerrainStorageTexels(size), sizeof(TerrainTexel));
+    SetTerrainMips(terrain);
+    terrain->maxHeight = 0;
+    InitPalette();
+}
 
-    UnloadImage(heightmap);
-    heightmapData = NULL;
+bool MapTerrain(Terrain *terrain, int size, const char *path, size_t offset)
+{
+    size_t bytes = TerrainStorageTexels(size) * sizeof(TerrainTexel);
+    SetTerrainSize(terrain, size);
+    terrain->texels = NULL;
+    InitPalette();
+
+#ifdef TERRAIN_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    // Private mapping: writes (entity painting) stay in memory
+    void *mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)offset);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
 
-    for (int i = 0; i < gameSettings.mapSize * gameSettings.mapSize; i++) {
-        float h_normalized = terrain->heightmapRaw[i] / 255.0f;
-        float h_curved = powf(h_normalized, 3.0f);
-        terrain->heightmapRaw[i] = (unsigned char)(h_curved * 255.0f);
+    terrain->mapping = mapping;
+    terrain->mappingSize = bytes;
+    terrain->texels = (TerrainTexel *)mapping;
+    SetTerrainMips(terrain);
+    UpdateTerrainMaxHeight(terrain);
+    return true;
+#else
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+
+    terrain->texels = (TerrainTexel *)malloc(bytes);
+    bool ok = terrain->texels && fseek(f, (long)offset, SEEK_SET) == 0 &&
+              fread(terrain->texels, 1, bytes, f) == bytes;
+    fclose(f);
+    if (!ok) {
+        UnloadTerrain(terrain);
+        return false;
     }
+    SetTerrainMips(terrain);
+    UpdateTerrainMaxHeight(terrain);
+    return true;
+#endif
+}
 
-    terrain->colormap = GenImageColor(gameSettings.mapSize, gameSettings.mapSize, BLACK);
-    ImageFormat(&terrain->colormap, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
-    terrain->colormapData = (Color*)terrain->colormap.data;
+// Rows handled per job batch and progress updates per stage. Both are fixed
+// so the batch layout (and the generated map) never depends on thread count.
+#define TERRAIN_BATCH_ROWS 16
+#define TERRAIN_PROGRESS_STEPS 8
 
-    for (int y = 0; y < gameSettings.mapSize; y++)
-    {
-      for (int x = 0; x < gameSettings.mapSize; x++)
-      {
-        int i = y * gameSettings.mapSize + x;
-        GenerateTerrainPixel(&terrain->colormapData[i], &terrain->heightmapRaw[i]);
-      }
+// Slope sums beyond this range all land on the darkest/brightest shade
+#define LIGHT_SLOPE_RANGE 16
+
+const char *terrainStageNames[TERRAIN_STAGE_COUNT] = { "noise", "classify", "lighting", "mips" };
+double terrainStageMs[TERRAIN_STAGE_COUNT];
+
+static unsigned char heightCurve[256];
+static unsigned char slopeShade[2 * LIGHT_SLOPE_RANGE + 1];
+
+// Palette entry nearest to the average of two entries, for mip colors
+static unsigned char mipBlend[PALETTE_SIZE * PALETTE_SHADES][PALETTE_SIZE * PALETTE_SHADES];
+static bool mipBlendReady = false;
+
+typedef struct {
+    Terrain *terrain;
+    int rowBase;
+    int pass;              // Pass of a multi-pass stage (LightingJob)
+    int offsetX;
+    int offsetY;
+    float noiseScale;
+    uint32_t classifyKey;
+} TerrainJob;
+
+static void BuildTerrainTables(void)
+{
+    // Cubic curve flattens lowlands and sharpens peaks
+    for (int h = 0; h < 256; h++) {
+        heightCurve[h] = (unsigned char)(powf(h / 255.0f, 3.0f) * 255.0f);
     }
 
     // Fast Gradient-Based Lighting
-    // Simulates light coming from Top-Left (North-West)
-    // We calculate the slope between current pixel and Right/Bottom neighbors.
+    // Simulates light coming from Top-Left (North-West). The light value
+    // only depends on the summed slope to the Right/Bottom neighbors.
     float shadowStrength = 2.5f;
+    for (int d = -LIGHT_SLOPE_RANGE; d <= LIGHT_SLOPE_RANGE; d++) {
+        slopeShade[d + LIGHT_SLOPE_RANGE] = (unsigned char)ShadeForLight((int)(d * shadowStrength));
+    }
+}
+
+static void NoiseJob(void *data, int start, int end)
+{
+    TerrainJob *job = (TerrainJob*)data;
+    Terrain *terrain = job->terrain;
+    int y0 = job->rowBase + start;
+    int rows = end - start;
 
-    for (int y = 0; y < gameSettings.mapSize - 1; y++)
+    // raylib scales the wider image side by the aspect ratio, so a
+    // size x rows band with a proportionally smaller scale samples the same
+    // noise field as one full-map image.
+    Image band = GenImagePerlinNoise(terrain->size, rows, job->offsetX, job->offsetY + y0,
+                                     job->noiseScale * rows / terrain->size);
+    ImageFormat(&band, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    const Color *src = (const Color*)band.data;
+
+    // Noise image is row-major, the terrain is tiled
+    for (int y = 0; y < rows; y++) {
+        for (int tx = 0; tx < terrain->size; tx += TERRAIN_TILE) {
+            TerrainTexel *dst = &terrain->texels[TerrainIndex(terrain, tx, y0 + y)];
+            const Color *row = src + y * terrain->size + tx;
+            for (int k = 0; k < TERRAIN_TILE; k++) {
+                dst[k] = PackTexel(heightCurve[row[k].r], 0);
+            }
+        }
+    }
+
+    UnloadImage(band);
+}
+
+static void ClassifyJob(void *data, int start, int end)
+{
+    TerrainJob *job = (TerrainJob*)data;
+    Terrain *terrain = job->terrain;
+
+    for (int y = job->rowBase + start; y < job->rowBase + end; y++)
     {
-      for (int x = 0; x < gameSettings.mapSize - 1; x++)
+      for (int x = 0; x < terrain->size; x++)
       {
-         int i = y * gameSettings.mapSize + x;
-
-         // Current height
-         int h = terrain->heightmapRaw[i];
-
-         if (((h < LEVEL_GRASS_LOW ) && (h > LEVEL_WATER)) || (h >= LEVEL_ROCK)){
-
-          // Neighbors (Right and Down)
-          int hRight = terrain->heightmapRaw[i + 1];
-          int hDown = terrain->heightmapRaw[i + gameSettings.mapSize];
-
-          // Calculate slope (gradient)
-          // If hRight > h, terrain slopes UP to the RIGHT (faces Left/West).
-          // If hDown > h, terrain slopes UP to the BOTTOM (faces Up/North).
-          // Since light is from Top-Left, these surfaces catch light.
-          int diffX = hRight - h;
-          int diffY = hDown - h;
-
-          int lightVal = (int)((diffX + diffY) * shadowStrength);
-
-          Color *col = &terrain->colormapData[i];
-
-          if (lightVal < 0) {
-              // Shadow: darker and more saturated
-              float factor = 1.0f + (lightVal * 0.04f);
-              if (factor < 0.25f) factor = 0.25f;
-
-              float r = (float)col->r * factor;
-              float g = (float)col->g * factor;
-              float b = (float)col->b * factor;
-
-              // Saturation boost
-              float gray = (r + g + b) / 3.0f;
-              float satAmount = 1.4f;
-
-              r = gray + (r - gray) * satAmount;
-              g = gray + (g - gray) * satAmount;
-              b = gray + (b - gray) * satAmount;
-
-              if (r < 0) r = 0;
-              if (r > 255) r = 255;
-              if (g < 0) g = 0;
-              if (g > 255) g = 255;
-              if (b < 0) b = 0;
-              if (b > 255) b = 255;
-
-              col->r = (unsigned char)r;
-              col->g = (unsigned char)g;
-              col->b = (unsigned char)b;
-          } else {
-              // Light: additive brightness
-              int r = col->r + lightVal;
-              int g = col->g + lightVal;
-              int b = col->b + lightVal;
-
-              if (r > 255) r = 255;
-              if (g > 255) g = 255;
-              if (b > 255) b = 255;
-
-              col->r = (unsigned char)r;
-              col->g = (unsigned char)g;
-              col->b = (unsigned char)b;
-          }
-        }
+        int i = TerrainIndex(terrain, x, y);
+        unsigned char h = TexelHeight(terrain->texels[i]);
+        unsigned char col;
+        // Keyed by map position, not storage index or visiting order
+        GenerateTerrainPixel(&col, &h, job->classifyKey, (uint32_t)y * terrain->size + x);
+        terrain->texels[i] = PackTexel(h, col);
       }
     }
 }
 
+static inline TerrainTexel LightTexel(TerrainTexel texel, int hRight, int hDown)
+{
+    int h = TexelHeight(texel);
+    bool lit = ((h < LEVEL_GRASS_LOW) && (h > LEVEL_WATER)) || (h >= LEVEL_ROCK);
+
+    // If hRight > h, terrain slopes UP to the RIGHT (faces Left/West).
+    // If hDown > h, terrain slopes UP to the BOTTOM (faces Up/North).
+    // Since light is from Top-Left, these surfaces catch light.
+    int slope = (hRight - h) + (hDown - h);
+    if (slope < -LIGHT_SLOPE_RANGE) slope = -LIGHT_SLOPE_RANGE;
+    if (slope > LIGHT_SLOPE_RANGE) slope = LIGHT_SLOPE_RANGE;
+
+    // Every palette entry has a precomputed shade ramp (palette.c),
+    // lighting only picks the step.
+    int base = TexelColorIndex(texel) / PALETTE_SHADES;
+    TerrainTexel shaded = PackTexel((unsigned char)h, ShadeIndex((PaletteColor)base, slopeShade[slope + LIGHT_SLOPE_RANGE]));
+    return lit ? shaded : texel;
+}
+
+static void LightingJob(void *data, int start, int end)
+{
+    TerrainJob *job = (TerrainJob*)data;
+    Terrain *terrain = job->terrain;
+    int last = terrain->size - 1; // Last row and column have no neighbor and stay unlit
+
+    // A band's last row reads the row below, the first of the next band.
+    // Even and odd bands of TERRAIN_BATCH_ROWS rows are shaded in separate
+    // passes, so no row is read while another batch writes it.
+    for (int y = job->rowBase + start; y < job->rowBase + end && y < last; y++) {
+        if ((((y - job->rowBase) / TERRAIN_BATCH_ROWS) & 1) != job->pass) continue;
+        for (int tx = 0; tx < terrain->size; tx += TERRAIN_TILE) {
+            TerrainTexel *row = &terrain->texels[TerrainIndex(terrain, tx, y)];
+            const TerrainTexel *down = &terrain->texels[TerrainIndex(terrain, tx, y + 1)];
+
+            // Tile rows are contiguous, only the last texel's right neighbor
+            // lives in the next tile.
+            for (int k = 0; k < TERRAIN_TILE - 1; k++) {
+                row[k] = LightTexel(row[k], TexelHeight(row[k + 1]), TexelHeight(down[k]));
+            }
+            if (tx + TERRAIN_TILE - 1 < last) {
+                int k = TERRAIN_TILE - 1;
+                int hRight = TexelHeight(terrain->texels[TerrainIndex(terrain, tx + TERRAIN_TILE, y)]);
+                row[k] = LightTexel(row[k], hRight, TexelHeight(down[k]));
+            }
+        }
+    }
+}
+
+static void BuildMipBlendTable(void)
+{
+    int count = PALETTE_SIZE * PALETTE_SHADES;
+    for (int a = 0; a < count; a++) {
+        for (int b = a; b < count; b++) {
+            Color ca = paletteColors[a];
+            Color cb = paletteColors[b];
+            Color mix = { (unsigned char)((ca.r + cb.r) / 2), (unsigned char)((ca.g + cb.g) / 2),
+                          (unsigned char)((ca.b + cb.b) / 2), 255 };
+            unsigned char index = (a == b) ? (unsigned char)a : PaletteIndex(mix);
+            mipBlend[a][b] = index;
+            mipBlend[b][a] = index;
+        }
+    }
+    mipBlendReady = true;
+}
+
+typedef struct {
+    Terrain *terrain;
+    int level;             // Level being built from level - 1
+} MipLevelJob;
+
+static inline TerrainTexel MipTexel(TerrainTexel a, TerrainTexel b, TerrainTexel c, TerrainTexel d)
+{
+    int h = TexelHeight(a);
+    if (TexelHeight(b) > h) h = TexelHeight(b);
+    if (TexelHeight(c) > h) h = TexelHeight(c);
+    if (TexelHeight(d) > h) h = TexelHeight(d);
+    unsigned char top = mipBlend[TexelColorIndex(a)][TexelColorIndex(b)];
+    unsigned char bottom = mipBlend[TexelColorIndex(c)][TexelColorIndex(d)];
+    return PackTexel((unsigned char)h, mipBlend[top][bottom]);
+}
+
+static void MipJob(void *data, int start, int end)
+{
+    MipLevelJob *job = (MipLevelJob*)data;
+    const Terrain *terrain = job->terrain;
+    int level = job->level;
+    int edge = terrain->size >> level;
+    TerrainTexel *dst = terrain->mips[level];
+
+    for (int y = start; y < end; y++) {
+        for (int x = 0; x < edge; x++) {
+            int px = x * 2;
+            int py = y * 2;
+            TerrainTexel a, b, c, d;
+            if (level == 1) {
+                // Parent is the tiled full-resolution map
+                a = terrain->texels[TerrainIndex(terrain, px, py)];
+                b = terrain->texels[TerrainIndex(terrain, px + 1, py)];
+                c = terrain->texels[TerrainIndex(terrain, px, py + 1)];
+                d = terrain->texels[TerrainIndex(terrain, px + 1, py + 1)];
+            } else {
+                const TerrainTexel *parent = terrain->mips[level - 1];
+                int parentEdge = edge * 2;
+                a = parent[py * parentEdge + px];
+                b = parent[py * parentEdge + px + 1];
+                c = parent[(py + 1) * parentEdge + px];
+                d = parent[(py + 1) * parentEdge + px + 1];
+            }
+            dst[y * edge + x] = MipTexel(a, b, c, d);
+        }
+    }
+}
+
+void BuildTerrainMips(Terrain *terrain)
+{
+    if (!mipBlendReady) BuildMipBlendTable();
+
+    MipLevelJob job = { .terrain = terrain };
+    for (int l = 1; l <= terrain->mipLevels; l++) {
+        job.level = l;
+        RunParallel(MipJob, &job, terrain->size >> l, TERRAIN_BATCH_ROWS);
+    }
+    UpdateTerrainMaxHeight(terrain);
+}
+
+// Runs one stage over all map rows in TERRAIN_PROGRESS_STEPS chunks,
+// reporting progress after each and recording the stage time. Each chunk
+// is run once per pass (job->pass) for stages that need more than one.
+static void RunTerrainStage(TerrainStage stage, JobFunc func, TerrainJob *job, int batchRows,
+                            int passes, TerrainProgressFunc progress)
+{
+    double start = GetEngineTime();
+    int rows = job->terrain->size;
+    int chunkRows = rows / TERRAIN_PROGRESS_STEPS;
+
+    if (progress) progress(stage, 0.0f);
+    for (int chunk = 0; chunk < TERRAIN_PROGRESS_STEPS; chunk++) {
+        job->rowBase = chunk * chunkRows;
+        for (int pass = 0; pass < passes; pass++) {
+            job->pass = pass;
+            RunParallel(func, job, chunkRows, batchRows);
+        }
+        if (progress) progress(stage, (float)(chunk + 1) / TERRAIN_PROGRESS_STEPS);
+    }
+
+    terrainStageMs[stage] = (GetEngineTime() - start) * 1000.0;
+    TraceLog(LOG_INFO, "TERRAIN: %s %.1f ms", terrainStageNames[stage], terrainStageMs[stage]);
+}
+
+void GenerateProceduralTerrain(Terrain *terrain, TerrainProgressFunc progress)
+{
+    // Note: DrawMessage moved to calling code to decouple UI from Logic
+
+    // Same seed, same world
+    uint32_t noiseKey = RandomKey(gameSettings.seed, RANDOM_STREAM_NOISE);
+    int offsetX = RandomRange(noiseKey, 0, 0, 10000);
+    int offsetY = RandomRange(noiseKey, 1, 0, 10000);
+
+    BuildTerrainTables();
+    AllocTerrain(terrain, gameSettings.mapSize);
+
+    TerrainJob job = {
+        .terrain = terrain,
+        .offsetX = offsetX,
+        .offsetY = offsetY,
+        .noiseScale = gameSettings.noiseScale,
+        .classifyKey = RandomKey(gameSettings.seed, RANDOM_STREAM_TERRAIN)
+    };
+
+    RunTerrainStage(TERRAIN_STAGE_NOISE, NoiseJob, &job, TERRAIN_BATCH_ROWS, 1, progress);
+
+    RunTerrainStage(TERRAIN_STAGE_CLASSIFY, ClassifyJob, &job, TERRAIN_BATCH_ROWS, 1, progress);
+
+    RunTerrainStage(TERRAIN_STAGE_LIGHTING, LightingJob, &job, TERRAIN_BATCH_ROWS, 2, progress);
+
+    // Levels shrink by 4x each, a single progress step is enough
+    double mipStart = GetEngineTime();
+    if (progress) progress(TERRAIN_STAGE_MIPS, 0.0f);
+    BuildTerrainMips(terrain);
+    if (progress) progress(TERRAIN_STAGE_MIPS, 1.0f);
+    terrainStageMs[TERRAIN_STAGE_MIPS] = (GetEngineTime() - mipStart) * 1000.0;
+    TraceLog(LOG_INFO, "TERRAIN: %s %.1f ms", terrainStageNames[TERRAIN_STAGE_MIPS], terrainStageMs[TERRAIN_STAGE_MIPS]);
+}
+
 void UnloadTerrain(Terrain *terrain) {
-    if (terrain->heightmapRaw) {
-        free(terrain->heightmapRaw);
-        terrain->heightmapRaw = NULL;
+#ifdef TERRAIN_MMAP
+    if (terrain->mapping) {
+        munmap(terrain->mapping, terrain->mappingSize);
+        terrain->mapping = NULL;
+        terrain->texels = NULL;
+        return;
+    }
+#endif
+    if (terrain->texels) {
+        free(terrain->texels);
+        terrain->texels = NULL;
     }
-    UnloadImage(terrain->colormap);
-    terrain->colormapData = NULL;
 }
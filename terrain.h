@@ -3,14 +3,95 @@
 
 #include "raylib.h"
 #include "constants.h"
+#include "palette.h"
+#include <stddef.h>
+
+// One packed texel per map cell: palette index (see palette.h) in the low
+// byte, height in the high byte. A single 16-bit load gives the renderer
+// both values.
+typedef unsigned short TerrainTexel;
+
+static inline TerrainTexel PackTexel(unsigned char height, unsigned char colorIndex) {
+    return (TerrainTexel)(colorIndex | (height << 8));
+}
+
+static inline unsigned char TexelHeight(TerrainTexel texel) {
+    return (unsigned char)(texel >> 8);
+}
+
+static inline unsigned char TexelColorIndex(TerrainTexel texel) {
+    return (unsigned char)(texel & 0xFF);
+}
+
+static inline TerrainTexel SetTexelHeight(TerrainTexel texel, unsigned char height) {
+    return (TerrainTexel)((texel & 0x00FF) | (height << 8));
+}
 
 typedef struct {
-    unsigned char *heightmapRaw;
-    Color *colormapData;
-    Image colormap;
+    TerrainTexel *texels;         // Tiled layout, address with TerrainIndex()
+    int size;                     // Edge length in texels (power of two, >= TERRAIN_TILE)
+    int mask;                     // size - 1, wraps map coordinates
+    int tileRowShift;             // log2(tiles per row)
+    void *mapping;                // World file mapping backing texels, NULL if heap allocated
+    size_t mappingSize;
+
+    // Mip level l (1..mipLevels) is (size >> l)^2 texels, row-major, each
+    // the max height and blended color of its 2x2 parent texels. Stored in
+    // the same block right after texels, mips[0] is unused.
+    TerrainTexel *mips[TERRAIN_MIP_LEVELS + 1];
+    int mipLevels;
+
+    // Upper bound of every texel height (exact after generation or
+    // loading, raised by entities painted into the texels)
+    int maxHeight;
 } Terrain;
 
-void GenerateProceduralTerrain(Terrain *terrain);
+// Index of texel (x, y) in the tiled arrays. x and y must be in [0, size).
+static inline int TerrainIndex(const Terrain *terrain, int x, int y) {
+    int tile = ((y >> TERRAIN_TILE_SHIFT) << terrain->tileRowShift) + (x >> TERRAIN_TILE_SHIFT);
+    return (tile << (2 * TERRAIN_TILE_SHIFT)) | ((y & TERRAIN_TILE_MASK) << TERRAIN_TILE_SHIFT) | (x & TERRAIN_TILE_MASK);
+}
+
+// Same as TerrainIndex, wrapping any coordinate onto the map.
+static inline int TerrainIndexWrapped(const Terrain *terrain, int x, int y) {
+    return TerrainIndex(terrain, x & terrain->mask, y & terrain->mask);
+}
+
+// Texel (x, y) of mip level (1..mipLevels), x and y in full map
+// coordinates in [0, size).
+static inline TerrainTexel TerrainMipTexel(const Terrain *terrain, int level, int x, int y) {
+    int edge = terrain->size >> level;
+    return terrain->mips[level][(y >> level) * edge + (x >> level)];
+}
+
+typedef enum {
+    TERRAIN_STAGE_NOISE,      // Perlin bands, height curve, tiled copy
+    TERRAIN_STAGE_CLASSIFY,   // Biome colors and grass height jitter
+    TERRAIN_STAGE_LIGHTING,   // Slope shading
+    TERRAIN_STAGE_MIPS,       // Mip pyramid
+    TERRAIN_STAGE_COUNT
+} TerrainStage;
+
+extern const char *terrainStageNames[TERRAIN_STAGE_COUNT];
+extern double terrainStageMs[TERRAIN_STAGE_COUNT]; // Timings of the last generation
+
+// Called on the calling thread between work chunks, progress in [0, 1].
+typedef void (*TerrainProgressFunc)(TerrainStage stage, float progress);
+
+// Texels stored for a map of the given size, full resolution plus mips
+size_t TerrainStorageTexels(int size);
+
+void AllocTerrain(Terrain *terrain, int size);
+// Backs the texels and mips with TerrainStorageTexels(size) texels stored
+// at offset in a file (see world.h). Mapped copy-on-write where supported,
+// so painted entities never reach the file and unvisited pages are never
+// read; read into memory otherwise. offset must be a multiple of the page
+// size.
+bool MapTerrain(Terrain *terrain, int size, const char *path, size_t offset);
+void GenerateProceduralTerrain(Terrain *terrain, TerrainProgressFunc progress);
+// Rebuilds the mips from the full-resolution texels (generation does this,
+// call it after editing the texels)
+void BuildTerrainMips(Terrain *terrain);
 void UnloadTerrain(Terrain *terrain);
 
 #endif // TERRAIN_H
\ No newline at end of file
@@ -17,6 +17,26 @@ void DrawLoadingMessage(const char* text) {
   EndDrawing();
 }
 
+void DrawLoadingProgress(const char* text, float progress) {
+  if (progress < 0.0f) progress = 0.0f;
+  if (progress > 1.0f) progress = 1.0f;
+
+  BeginDrawing();
+  ClearBackground(THEME_BG);
+
+  int textWidth = MeasureText(text, 20);
+  int x = GetScreenWidth()/2 - textWidth/2;
+  int y = GetScreenHeight()/2 - 10;
+  int barWidth = textWidth + 40;
+
+  DrawText(text, x, y, 20, THEME_ACCENT_LIGHT);
+  DrawRectangleLines(x - 20, y - 20, barWidth, 60, THEME_ACCENT);
+  DrawRectangle(x - 20, y + 44, (int)(barWidth * progress), 4, THEME_ACCENT);
+  DrawText(TextFormat("SYSTEM INITIALIZATION... %d%%", (int)(progress * 100.0f)), x, y + 50, 10, THEME_TEXT_DIM);
+
+  EndDrawing();
+}
+
 void DrawGameUI(const EngineState *state) {
     // HUD overlay frame
     DrawRectangleLines(10, 10, GetScreenWidth() - 20, GetScreenHeight() - 20, THEME_GRID_LINE);
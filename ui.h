@@ -6,6 +6,7 @@
 #include "constants.h"
 
 void DrawLoadingMessage(const char* text);
+void DrawLoadingProgress(const char* text, float progress); // progress in [0, 1]
 void DrawGameUI(const EngineState *state);
 
 #endif // UI_H
@@ -0,0 +1,167 @@
+#include "world.h"
+#include "settings.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t seed;
+    int32_t mapSize;
+    float noiseScale;
+    int32_t tileShift;        // TERRAIN_TILE_SHIFT the texels were stored with
+    int32_t entityCount;
+    uint32_t spawnSerial;
+    uint64_t texelOffset;
+    uint64_t texelBytes;
+} WorldHeader;
+
+typedef struct {
+    int32_t type;
+    int32_t facing;
+    float x, y;
+    float dx, dy;
+    float speed;
+    uint32_t rngKey;
+    uint32_t rngCounter;
+    char model[64];           // Model name, empty for the procedural fallback
+} WorldEntity;
+
+const char *GetWorldCachePath(void)
+{
+    static char path[256];
+    snprintf(path, sizeof(path), "%s/world_%d_%u.vxw", WORLD_CACHE_DIR, gameSettings.mapSize, gameSettings.seed);
+    return path;
+}
+
+static const VoxelModel *FindModel(EntityType type, const char *name)
+{
+    if (name[0] == 0) return NULL;
+    for (int i = 0; i < modelRegistry.count; i++) {
+        const VoxelModel *m = &modelRegistry.models[i];
+        if (m->type == type && strncmp(m->name, name, sizeof(m->name)) == 0) return m;
+    }
+    return NULL;
+}
+
+static uint64_t TexelOffset(int entityCount)
+{
+    uint64_t end = sizeof(WorldHeader) + (uint64_t)entityCount * sizeof(WorldEntity);
+    return (end + WORLD_DATA_ALIGN - 1) / WORLD_DATA_ALIGN * WORLD_DATA_ALIGN;
+}
+
+bool LoadWorld(const char *path, Terrain *terrain, EntityManager *manager)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+
+    WorldHeader header;
+    bool valid = fread(&header, sizeof(header), 1, f) == 1 &&
+                 memcmp(header.magic, WORLD_MAGIC, 4) == 0 &&
+                 header.version == WORLD_VERSION &&
+                 header.seed == gameSettings.seed &&
+                 header.mapSize == gameSettings.mapSize &&
+                 header.noiseScale == gameSettings.noiseScale &&
+                 header.tileShift == TERRAIN_TILE_SHIFT &&
+                 header.entityCount >= 0 && header.entityCount <= manager->capacity &&
+                 header.texelOffset == TexelOffset(header.entityCount) &&
+                 header.texelBytes == (uint64_t)TerrainStorageTexels(header.mapSize) * sizeof(TerrainTexel);
+
+    WorldEntity *records = NULL;
+    if (valid && header.entityCount > 0) {
+        records = (WorldEntity *)malloc(header.entityCount * sizeof(WorldEntity));
+        valid = records && fread(records, sizeof(WorldEntity), header.entityCount, f) == (size_t)header.entityCount;
+    }
+
+    // A file cut short by a crash mid-save would map past its end
+    if (valid) {
+        valid = fseek(f, 0, SEEK_END) == 0 && (uint64_t)ftell(f) >= header.texelOffset + header.texelBytes;
+    }
+    fclose(f);
+
+    if (!valid || !MapTerrain(terrain, header.mapSize, path, (size_t)header.texelOffset)) {
+        free(records);
+        TraceLog(LOG_INFO, "WORLD: No usable cache at %s", path);
+        return false;
+    }
+
+    for (int i = 0; i < header.entityCount; i++) {
+        const WorldEntity *r = &records[i];
+        EntityType type = (EntityType)r->type;
+        int e = GetEntityIndex(manager, AddEntityFromModel(manager, type, r->x, r->y, FindModel(type, r->model)));
+        if (e < 0) break;
+
+        manager->facing[e] = (unsigned char)r->facing;
+        manager->dx[e] = r->dx;
+        manager->dy[e] = r->dy;
+        manager->speed[e] = r->speed;
+        manager->rngKey[e] = r->rngKey;
+        manager->rngCounter[e] = r->rngCounter;
+    }
+    manager->spawnSerial = header.spawnSerial;
+    free(records);
+
+    TraceLog(LOG_INFO, "WORLD: Loaded %s (%d entities)", path, header.entityCount);
+    return true;
+}
+
+bool SaveWorld(const char *path, const Terrain *terrain, const EntityManager *manager)
+{
+    MakeDirectory(WORLD_CACHE_DIR);
+
+    // Written next to the target and renamed, a crash never leaves a
+    // half-written world under the real name
+    char tmpPath[272];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *f = fopen(tmpPath, "wb");
+    if (!f) return false;
+
+    WorldHeader header = {
+        .version = WORLD_VERSION,
+        .seed = gameSettings.seed,
+        .mapSize = terrain->size,
+        .noiseScale = gameSettings.noiseScale,
+        .tileShift = TERRAIN_TILE_SHIFT,
+        .entityCount = manager->count,
+        .spawnSerial = manager->spawnSerial,
+        .texelBytes = (uint64_t)TerrainStorageTexels(terrain->size) * sizeof(TerrainTexel)
+    };
+    memcpy(header.magic, WORLD_MAGIC, 4);
+
+    header.texelOffset = TexelOffset(header.entityCount);
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    for (int i = 0; ok && i < manager->count; i++) {
+        WorldEntity r = {
+            .type = manager->type[i],
+            .facing = manager->facing[i],
+            .x = manager->x[i], .y = manager->y[i],
+            .dx = manager->dx[i], .dy = manager->dy[i],
+            .speed = manager->speed[i],
+            .rngKey = manager->rngKey[i],
+            .rngCounter = manager->rngCounter[i]
+        };
+        if (manager->model[i]) snprintf(r.model, sizeof(r.model), "%s", manager->model[i]->name);
+        ok = fwrite(&r, sizeof(r), 1, f) == 1;
+    }
+
+    ok = ok && fseek(f, (long)header.texelOffset, SEEK_SET) == 0 &&
+         fwrite(terrain->texels, 1, header.texelBytes, f) == header.texelBytes;
+    ok = (fclose(f) == 0) && ok;
+
+#ifdef _WIN32
+    if (ok) remove(path); // rename() does not replace files on Windows
+#endif
+    if (ok) ok = rename(tmpPath, path) == 0;
+    if (!ok) {
+        remove(tmpPath);
+        TraceLog(LOG_WARNING, "WORLD: Failed to save %s", path);
+        return false;
+    }
+
+    TraceLog(LOG_INFO, "WORLD: Saved %s", path);
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "terrain.h"
+#include "entities.h"
+
+// Binary world cache. A generated world (terrain texels and spawned
+// entities) is saved per map size and seed; loading maps the texels
+// straight from the file instead of regenerating them.
+//
+// Layout: WorldHeader, entityCount WorldEntity records, then the tiled
+// texels and the terrain mips at texelOffset (WORLD_DATA_ALIGN aligned so
+// they can be mapped).
+
+#define WORLD_MAGIC "VXWD"
+#define WORLD_VERSION 2        // Bump when generation or the layout changes
+#define WORLD_DATA_ALIGN 65536 // Covers 4K, 16K and 64K pages
+
+#define WORLD_CACHE_DIR "cache"
+
+// Path of the cache file for the current map size and seed
+const char *GetWorldCachePath(void);
+
+// Loads a world saved for the current gameSettings (map size, seed, noise).
+// Returns false if the file is missing, stale or invalid, the caller then
+// generates the world. Models must be loaded first (InitEntityManager).
+bool LoadWorld(const char *path, Terrain *terrain, EntityManager *manager);
+
+// Writes terrain and entities. Call before entities are painted.
+bool SaveWorld(const char *path, const Terrain *terrain, const EntityManager *manager);
+
+#endif // WORLD_H